@@ -0,0 +1,149 @@
+// OS 2025 EX1
+
+#include "atomic_latency.h"
+#include "smt_interference.h"
+#include <emmintrin.h>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#define CACHE_LINE_SIZE 64
+
+/**
+ * One cache line of the chase. next is the index of the following line, scratch is the word the operations work on.
+ */
+struct chase_line {
+    uint64_t next;
+    uint64_t scratch;
+    char pad[CACHE_LINE_SIZE - 2 * sizeof(uint64_t)];
+};
+
+/**
+ * Chases steps lines starting at line cur, executing op on every line.
+ * @return the line the chase stopped at.
+ */
+static uint64_t chase(struct chase_line* lines, uint64_t steps, enum atomic_op op, uint64_t cur, uint64_t zero)
+{
+    register uint64_t r = 0;
+    switch (op) {
+        case ATOMIC_LOAD:
+            for (register uint64_t i = 0; i < steps; i++) {
+                cur = lines[cur].next;
+            }
+            break;
+        case ATOMIC_XADD:
+            for (register uint64_t i = 0; i < steps; i++) {
+                r = __atomic_fetch_add(&lines[cur].scratch, 1, __ATOMIC_SEQ_CST);
+                cur = lines[cur ^ (r & zero)].next;
+            }
+            break;
+        case ATOMIC_CMPXCHG:
+            for (register uint64_t i = 0; i < steps; i++) {
+                // Whether the exchange succeeds does not matter, lock cmpxchg locks the line either way.
+                r = cur;
+                __atomic_compare_exchange_n(&lines[cur].scratch, &r, cur, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+                cur = lines[cur ^ (r & zero)].next;
+            }
+            break;
+        case ATOMIC_XCHG:
+            for (register uint64_t i = 0; i < steps; i++) {
+                r = __atomic_exchange_n(&lines[cur].scratch, cur, __ATOMIC_SEQ_CST);
+                cur = lines[cur ^ (r & zero)].next;
+            }
+            break;
+        case ATOMIC_MOV_MFENCE:
+            for (register uint64_t i = 0; i < steps; i++) {
+                // The fence holds the next load back until the store (and its read for ownership) is done.
+                lines[cur].scratch = cur;
+                _mm_mfence();
+                cur = lines[cur].next;
+            }
+            break;
+        default:
+            throw std::invalid_argument("unknown atomic operation");
+    }
+    return cur;
+}
+
+struct measurement measure_atomic_latency(uint64_t repeat, uint64_t size, enum atomic_op op, uint64_t zero,
+                                          int remote_cpu)
+{
+    uint64_t nlines = size / sizeof(struct chase_line);
+    nlines = nlines == 0 ? 1 : nlines;
+    uint64_t passes = (repeat + nlines - 1) / nlines; // Make sure passes * nlines >= repeat
+    passes = passes == 0 ? 1 : passes;
+
+    void* mem;
+    if (posix_memalign(&mem, CACHE_LINE_SIZE, nlines * sizeof(struct chase_line)) != 0) {
+        throw std::runtime_error("cannot allocate the chase buffer");
+    }
+    struct chase_line* lines = (struct chase_line*) mem;
+    array_element_t* order = (array_element_t*) malloc(nlines * sizeof(array_element_t));
+    if (order == NULL) {
+        free(lines);
+        throw std::runtime_error("cannot allocate the chase order");
+    }
+    init_chase(order, nlines);
+    for (uint64_t i = 0; i < nlines; i++) {
+        lines[i].next = order[i];
+        lines[i].scratch = 0;
+    }
+    free(order);
+
+    uint64_t cur = chase(lines, nlines, op, 0, zero); // Warm up: brings the buffer to the cache level it fits in
+    uint64_t elapsed = 0;
+
+    if (remote_cpu < 0) {
+        struct timespec t0;
+        timespec_get(&t0, TIME_UTC);
+        cur = chase(lines, passes * nlines, op, cur, zero);
+        struct timespec t1;
+        timespec_get(&t1, TIME_UTC);
+        elapsed = nanosectime(t1) - nanosectime(t0);
+    } else {
+        // The remote thread dirties every line when pass becomes odd and makes it even again when it is done.
+        std::atomic<uint64_t> pass(0);
+        std::atomic<bool> pinned(true);
+        std::thread remote([&]() {
+            try {
+                pin_to_cpu(remote_cpu);
+            } catch (const std::exception&) {
+                pinned = false;
+            }
+            for (uint64_t p = 0; p < passes; p++) {
+                while (pass.load() % 2 == 0) {
+                    std::this_thread::yield();
+                }
+                for (uint64_t i = 0; i < nlines; i++) {
+                    lines[i].scratch++;
+                }
+                pass.fetch_add(1);
+            }
+        });
+        for (uint64_t p = 0; p < passes; p++) {
+            pass.fetch_add(1);
+            while (pass.load() % 2 == 1) {
+                std::this_thread::yield();
+            }
+            struct timespec t0;
+            timespec_get(&t0, TIME_UTC);
+            cur = chase(lines, nlines, op, cur, zero);
+            struct timespec t1;
+            timespec_get(&t1, TIME_UTC);
+            elapsed += nanosectime(t1) - nanosectime(t0);
+        }
+        remote.join();
+        if (!pinned.load()) {
+            free(lines);
+            throw std::runtime_error("cannot pin thread to cpu " + std::to_string(remote_cpu));
+        }
+    }
+    free(lines);
+
+    struct measurement result;
+    result.baseline = 0;
+    result.access_time = (double) elapsed / (passes * nlines);
+    result.rnd = cur;
+    return result;
+}
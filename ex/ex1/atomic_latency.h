@@ -0,0 +1,39 @@
+// OS 2025 EX1
+
+#ifndef _ATOMIC_LATENCY_H
+#define _ATOMIC_LATENCY_H
+
+#include "memory_latency.h"
+
+/**
+ * The operations measured by the atomic mode. Each one is executed on the line the pointer chase is currently at.
+ */
+enum atomic_op {
+    ATOMIC_LOAD,        // a plain load of the next pointer, the reference latency of the chase
+    ATOMIC_XADD,        // lock xadd
+    ATOMIC_CMPXCHG,     // lock cmpxchg
+    ATOMIC_XCHG,        // xchg (implicitly locked)
+    ATOMIC_MOV_MFENCE,  // a plain store followed by mfence
+    ATOMIC_OP_COUNT
+};
+
+
+/**
+ * Measures the average latency of an operation on a line, while chasing pointers over random lines of a buffer.
+ * The next line of the chase depends on the result of the operation, so the operations cannot overlap.
+ * @param repeat - the minimal number of operations to execute for and average on.
+ * @param size - the size in bytes of the buffer, which decides which cache level the lines live in.
+ * @param op - the operation to measure.
+ * @param zero - a variable containing zero in a way that the compiler doesn't "know" it in compilation time.
+ * @param remote_cpu - if not negative, a thread pinned to this cpu writes to every line of the buffer before each pass
+ *                     over it, so every operation finds its line modified by another core. The calling thread is
+ *                     expected to be pinned to a different cpu.
+ * @return struct measurement containing the measurement with the following fields:
+ *      double baseline - always 0, the chase has no meaningful variant without memory accesses.
+ *      double access_time - the average time (ns) of one step of the chase, including the operation.
+ *      uint64_t rnd - the last line of the chase, returned to prevent compiler optimizations.
+ */
+struct measurement measure_atomic_latency(uint64_t repeat, uint64_t size, enum atomic_op op, uint64_t zero,
+                                          int remote_cpu);
+
+#endif
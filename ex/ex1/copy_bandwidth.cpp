@@ -0,0 +1,220 @@
+// OS 2025 EX1
+
+#include "copy_bandwidth.h"
+#include <immintrin.h>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#define PAGE_SIZE 4096
+#define CACHE_LINE_SIZE 64
+#define FILL_BYTE 0x5A
+
+static void copy_glibc(void* dst, const void* src, size_t n)
+{
+    memcpy(dst, src, n);
+}
+
+static void copy_rep_movsb(void* dst, const void* src, size_t n)
+{
+    asm volatile("rep movsb" : "+D" (dst), "+S" (src), "+c" (n) : : "memory");
+}
+
+__attribute__((target("avx2")))
+static void copy_avx2(void* dst, const void* src, size_t n)
+{
+    char* d = (char*) dst;
+    const char* s = (const char*) src;
+    size_t i = 0;
+    for (; i + 4 * sizeof(__m256i) <= n; i += 4 * sizeof(__m256i)) {
+        __m256i a = _mm256_loadu_si256((const __m256i*) (s + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*) (s + i + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i*) (s + i + 64));
+        __m256i e = _mm256_loadu_si256((const __m256i*) (s + i + 96));
+        _mm256_storeu_si256((__m256i*) (d + i), a);
+        _mm256_storeu_si256((__m256i*) (d + i + 32), b);
+        _mm256_storeu_si256((__m256i*) (d + i + 64), c);
+        _mm256_storeu_si256((__m256i*) (d + i + 96), e);
+    }
+    for (; i + sizeof(__m256i) <= n; i += sizeof(__m256i)) {
+        _mm256_storeu_si256((__m256i*) (d + i), _mm256_loadu_si256((const __m256i*) (s + i)));
+    }
+    for (; i < n; i++) {
+        d[i] = s[i];
+    }
+}
+
+// Non-temporal stores bypass the caches and need an aligned destination, so the unaligned head and the tail are copied
+// with memcpy. SSE2 streaming stores are used since every x86-64 cpu has them.
+static void copy_nt(void* dst, const void* src, size_t n)
+{
+    char* d = (char*) dst;
+    const char* s = (const char*) src;
+    size_t head = (sizeof(__m128i) - ((uintptr_t) d & (sizeof(__m128i) - 1))) & (sizeof(__m128i) - 1);
+    head = head > n ? n : head;
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+    for (; n >= 4 * sizeof(__m128i); n -= 4 * sizeof(__m128i), d += 4 * sizeof(__m128i), s += 4 * sizeof(__m128i)) {
+        _mm_stream_si128((__m128i*) d, _mm_loadu_si128((const __m128i*) s));
+        _mm_stream_si128((__m128i*) (d + 16), _mm_loadu_si128((const __m128i*) (s + 16)));
+        _mm_stream_si128((__m128i*) (d + 32), _mm_loadu_si128((const __m128i*) (s + 32)));
+        _mm_stream_si128((__m128i*) (d + 48), _mm_loadu_si128((const __m128i*) (s + 48)));
+    }
+    for (; n >= sizeof(__m128i); n -= sizeof(__m128i), d += sizeof(__m128i), s += sizeof(__m128i)) {
+        _mm_stream_si128((__m128i*) d, _mm_loadu_si128((const __m128i*) s));
+    }
+    memcpy(d, s, n);
+    _mm_sfence(); // Make the streaming stores globally visible before the copy is considered done
+}
+
+static void set_glibc(void* dst, const void* src, size_t n)
+{
+    memset(dst, FILL_BYTE, n);
+}
+
+static void set_rep_stosb(void* dst, const void* src, size_t n)
+{
+    asm volatile("rep stosb" : "+D" (dst), "+c" (n) : "a" (FILL_BYTE) : "memory");
+}
+
+__attribute__((target("avx2")))
+static void set_avx2(void* dst, const void* src, size_t n)
+{
+    char* d = (char*) dst;
+    __m256i fill = _mm256_set1_epi8(FILL_BYTE);
+    size_t i = 0;
+    for (; i + 4 * sizeof(__m256i) <= n; i += 4 * sizeof(__m256i)) {
+        _mm256_storeu_si256((__m256i*) (d + i), fill);
+        _mm256_storeu_si256((__m256i*) (d + i + 32), fill);
+        _mm256_storeu_si256((__m256i*) (d + i + 64), fill);
+        _mm256_storeu_si256((__m256i*) (d + i + 96), fill);
+    }
+    for (; i + sizeof(__m256i) <= n; i += sizeof(__m256i)) {
+        _mm256_storeu_si256((__m256i*) (d + i), fill);
+    }
+    for (; i < n; i++) {
+        d[i] = FILL_BYTE;
+    }
+}
+
+static void set_nt(void* dst, const void* src, size_t n)
+{
+    char* d = (char*) dst;
+    __m128i fill = _mm_set1_epi8(FILL_BYTE);
+    size_t head = (sizeof(__m128i) - ((uintptr_t) d & (sizeof(__m128i) - 1))) & (sizeof(__m128i) - 1);
+    head = head > n ? n : head;
+    memset(d, FILL_BYTE, head);
+    d += head;
+    n -= head;
+    for (; n >= sizeof(__m128i); n -= sizeof(__m128i), d += sizeof(__m128i)) {
+        _mm_stream_si128((__m128i*) d, fill);
+    }
+    memset(d, FILL_BYTE, n);
+    _mm_sfence();
+}
+
+const struct copy_implementation memcpy_implementations[] = {
+    {"memcpy", copy_glibc, 0},
+    {"rep_movsb", copy_rep_movsb, 0},
+    {"avx2", copy_avx2, 1},
+    {"nt", copy_nt, 0},
+};
+const int memcpy_implementations_count = sizeof(memcpy_implementations) / sizeof(memcpy_implementations[0]);
+
+const struct copy_implementation memset_implementations[] = {
+    {"memset", set_glibc, 0},
+    {"rep_stosb", set_rep_stosb, 0},
+    {"avx2", set_avx2, 1},
+    {"nt", set_nt, 0},
+};
+const int memset_implementations_count = sizeof(memset_implementations) / sizeof(memset_implementations[0]);
+
+enum copy_residency parse_copy_residency(const char* name)
+{
+    if (strcmp(name, "hot") == 0) {
+        return COPY_HOT;
+    }
+    if (strcmp(name, "cold") == 0) {
+        return COPY_COLD;
+    }
+    throw std::invalid_argument(std::string("unknown residency ") + name);
+}
+
+/**
+ * Evicts a range of memory from all cache levels.
+ * @param p - the start of the range.
+ * @param n - the length of the range in bytes.
+ */
+static void flush_range(const void* p, size_t n)
+{
+    const char* c = (const char*) p;
+    for (size_t off = 0; off < n; off += CACHE_LINE_SIZE) {
+        _mm_clflush(c + off);
+    }
+    if (n > 0) {
+        _mm_clflush(c + n - 1);
+    }
+}
+
+double measure_copy_bandwidth(const struct copy_implementation* impl, uint64_t repeat, uint64_t size,
+                              uint64_t src_align, uint64_t dst_align, enum copy_residency residency)
+{
+    if (impl->needs_avx2 && !__builtin_cpu_supports("avx2")) {
+        return NAN;
+    }
+    uint64_t copies = (repeat + size - 1) / size; // Make sure copies * size >= repeat
+    copies = copies == 0 ? 1 : copies;
+
+    void* src_base;
+    void* dst_base;
+    if (posix_memalign(&src_base, PAGE_SIZE, size + src_align + PAGE_SIZE) != 0) {
+        throw std::runtime_error("cannot allocate the source buffer");
+    }
+    if (posix_memalign(&dst_base, PAGE_SIZE, size + dst_align + PAGE_SIZE) != 0) {
+        free(src_base);
+        throw std::runtime_error("cannot allocate the destination buffer");
+    }
+    char* src = (char*) src_base + src_align;
+    char* dst = (char*) dst_base + dst_align;
+    memset(src, 1, size);
+    impl->copy(dst, src, size); // Warm up: faults in the destination and the code
+
+    uint64_t elapsed = 0;
+    if (residency == COPY_HOT) {
+        struct timespec t0;
+        timespec_get(&t0, TIME_UTC);
+        for (register uint64_t i = 0; i < copies; i++) {
+            impl->copy(dst, src, size);
+        }
+        struct timespec t1;
+        timespec_get(&t1, TIME_UTC);
+        elapsed = nanosectime(t1) - nanosectime(t0);
+    } else {
+        // Every copy is timed on its own since the flushes must not be counted. The cost of reading the clock is
+        // measured the same way and subtracted, like the baseline of the latency measurements.
+        uint64_t baseline = 0;
+        for (uint64_t i = 0; i < copies; i++) {
+            flush_range(src, size);
+            flush_range(dst, size);
+            _mm_mfence();
+            struct timespec t0;
+            timespec_get(&t0, TIME_UTC);
+            struct timespec t1;
+            timespec_get(&t1, TIME_UTC);
+            impl->copy(dst, src, size);
+            struct timespec t2;
+            timespec_get(&t2, TIME_UTC);
+            baseline += nanosectime(t1) - nanosectime(t0);
+            elapsed += nanosectime(t2) - nanosectime(t1);
+        }
+        elapsed = elapsed > baseline ? elapsed - baseline : 1;
+    }
+
+    free(src_base);
+    free(dst_base);
+    elapsed = elapsed == 0 ? 1 : elapsed;
+    return (double) (size * copies) / elapsed;
+}
@@ -0,0 +1,61 @@
+// OS 2025 EX1
+
+#ifndef _COPY_BANDWIDTH_H
+#define _COPY_BANDWIDTH_H
+
+#include "memory_latency.h"
+
+/**
+ * The smallest copy size the memcpy and memset modes start their sweep from.
+ */
+#define COPY_MIN_SIZE 8
+
+
+/**
+ * Where the buffers live when a copy starts.
+ */
+enum copy_residency {
+    COPY_HOT,   // the same buffers are copied over and over, so they stay in the closest cache they fit in
+    COPY_COLD   // both buffers are flushed from all caches before every copy
+};
+
+
+/**
+ * A copy (or fill) implementation. The memset implementations fill dst with a constant byte and ignore src.
+ */
+typedef void (*copy_function_t)(void* dst, const void* src, size_t n);
+
+struct copy_implementation {
+    const char* name;
+    copy_function_t copy;
+    int needs_avx2;
+};
+
+extern const struct copy_implementation memcpy_implementations[];
+extern const int memcpy_implementations_count;
+extern const struct copy_implementation memset_implementations[];
+extern const int memset_implementations_count;
+
+
+/**
+ * Parses the name of a residency ("hot" or "cold").
+ * @param name - the name to parse.
+ * @return the matching residency. Throws std::invalid_argument for an unknown name.
+ */
+enum copy_residency parse_copy_residency(const char* name);
+
+
+/**
+ * Measures the bandwidth of a copy implementation for a single copy size.
+ * @param impl - the implementation to measure.
+ * @param repeat - the minimal number of bytes to copy for and average on (at least one copy is made).
+ * @param size - the number of bytes of every copy.
+ * @param src_align - the offset in bytes of the source from a page boundary.
+ * @param dst_align - the offset in bytes of the destination from a page boundary.
+ * @param residency - where the buffers live when each copy starts.
+ * @return the bandwidth in GB/s (bytes per ns), or NAN if the implementation is not supported by this cpu.
+ */
+double measure_copy_bandwidth(const struct copy_implementation* impl, uint64_t repeat, uint64_t size,
+                              uint64_t src_align, uint64_t dst_align, enum copy_residency residency);
+
+#endif
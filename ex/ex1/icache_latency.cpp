@@ -0,0 +1,125 @@
+// OS 2025 EX1
+
+#include "icache_latency.h"
+#include <sys/mman.h>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#define JMP_REL32_OPCODE 0xE9
+#define JMP_REL32_LENGTH 5
+#define RET_OPCODE 0xC3
+#define INT3_OPCODE 0xCC
+
+typedef void (*code_chain_t)(void);
+
+/**
+ * Maps an executable buffer and writes a chain of jump blocks into it.
+ * @param nblocks - the number of blocks in the chain.
+ * @param random - if non-zero the blocks are chained in a random order, otherwise in address order.
+ * @param length - filled with the length in bytes of the mapping, to be passed to munmap.
+ * @return the mapped buffer. The chain starts at the beginning of the buffer.
+ */
+static uint8_t* build_chain(uint64_t nblocks, int random, size_t* length)
+{
+    *length = nblocks * ICACHE_BLOCK_SIZE;
+    void* mem = mmap(NULL, *length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        throw std::runtime_error("mmap of the code buffer failed");
+    }
+    uint8_t* code = (uint8_t*) mem;
+    memset(code, INT3_OPCODE, *length); // Padding is never executed, trap if it ever is
+
+    // order[k] is the index of the k-th block of the chain. The chain always starts at block 0.
+    std::vector<uint64_t> order(nblocks);
+    for (uint64_t k = 0; k < nblocks; k++) {
+        order[k] = k;
+    }
+    if (random) {
+        std::mt19937_64 gen(12345);
+        for (uint64_t k = nblocks - 1; k > 1; k--) {
+            std::uniform_int_distribution<uint64_t> pick(1, k);
+            std::swap(order[k], order[pick(gen)]);
+        }
+    }
+
+    for (uint64_t k = 0; k + 1 < nblocks; k++) {
+        uint8_t* src = code + order[k] * ICACHE_BLOCK_SIZE;
+        uint8_t* dst = code + order[k + 1] * ICACHE_BLOCK_SIZE;
+        int32_t rel = (int32_t) (dst - (src + JMP_REL32_LENGTH));
+        src[0] = JMP_REL32_OPCODE;
+        memcpy(src + 1, &rel, sizeof(rel));
+    }
+    code[order[nblocks - 1] * ICACHE_BLOCK_SIZE] = RET_OPCODE;
+
+    if (mprotect(code, *length, PROT_READ | PROT_EXEC) != 0) {
+        munmap(code, *length);
+        throw std::runtime_error("mprotect of the code buffer failed");
+    }
+    return code;
+}
+
+/**
+ * Measures the average cost of executing one block of a generated chain of jumps.
+ * @param repeat - the minimal number of blocks to execute for and average on.
+ * @param code_size - the size in bytes of the generated code.
+ * @param random - if non-zero the blocks are chained in a random order, otherwise in address order.
+ * @return struct measurement containing the measurement with the following fields:
+ *      double baseline - the average time (ns) per block of calling an empty stub (the call/ret overhead).
+ *      double access_time - the average time (ns) per block of calling the chain.
+ *      uint64_t rnd - the number of blocks in the chain.
+ */
+struct measurement measure_icache_latency(uint64_t repeat, uint64_t code_size, int random)
+{
+#ifndef __x86_64__
+    throw std::runtime_error("the icache mode generates x86-64 code only");
+#endif
+    uint64_t nblocks = code_size / ICACHE_BLOCK_SIZE;
+    nblocks = nblocks == 0 ? 1 : nblocks;
+    uint64_t calls = (repeat + nblocks - 1) / nblocks; // Make sure calls * nblocks >= repeat
+    calls = calls == 0 ? 1 : calls;
+
+    size_t chain_length, stub_length;
+    uint8_t* chain_code = build_chain(nblocks, random, &chain_length);
+    uint8_t* stub_code = build_chain(1, 0, &stub_length);
+    code_chain_t chain = (code_chain_t) chain_code;
+    code_chain_t stub = (code_chain_t) stub_code;
+
+    // Warm up both buffers so the first timed call does not pay for the page faults:
+    chain();
+    stub();
+
+    // Baseline measurement:
+    struct timespec t0;
+    timespec_get(&t0, TIME_UTC);
+    for (register uint64_t i = 0; i < calls; i++)
+    {
+        stub();
+    }
+    struct timespec t1;
+    timespec_get(&t1, TIME_UTC);
+
+    // Code fetch measurement:
+    struct timespec t2;
+    timespec_get(&t2, TIME_UTC);
+    for (register uint64_t i = 0; i < calls; i++)
+    {
+        chain();
+    }
+    struct timespec t3;
+    timespec_get(&t3, TIME_UTC);
+
+    munmap(chain_code, chain_length);
+    munmap(stub_code, stub_length);
+
+    // Calculate baseline and code fetch times per block:
+    double baseline_per_block = (double)(nanosectime(t1) - nanosectime(t0)) / (calls * nblocks);
+    double fetch_per_block = (double)(nanosectime(t3) - nanosectime(t2)) / (calls * nblocks);
+    struct measurement result;
+
+    result.baseline = baseline_per_block;
+    result.access_time = fetch_per_block;
+    result.rnd = nblocks;
+    return result;
+}
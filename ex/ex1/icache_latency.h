@@ -0,0 +1,29 @@
+// OS 2025 EX1
+
+#ifndef _ICACHE_LATENCY_H
+#define _ICACHE_LATENCY_H
+
+#include "memory_latency.h"
+
+/**
+ * The distance in bytes between two consecutive jump blocks in the generated code (one block per cache line).
+ */
+#define ICACHE_BLOCK_SIZE 64
+
+
+/**
+ * Measures the average cost of executing one block of a generated chain of jumps.
+ * The chain is written at runtime into an mmap'd executable buffer of code_size bytes. Every block holds a single
+ * 'jmp' to the next block of the chain, and the last block holds a 'ret', so executing the chain touches exactly
+ * one cache line per block. Growing code_size pushes the code footprint past L1I, the uop cache, L2 and the iTLB.
+ * @param repeat - the minimal number of blocks to execute for and average on.
+ * @param code_size - the size in bytes of the generated code, at most INT32_MAX, the reach of a 'jmp rel32'.
+ * @param random - if non-zero the blocks are chained in a random order, otherwise in address order.
+ * @return struct measurement containing the measurement with the following fields:
+ *      double baseline - the average time (ns) per block of calling an empty stub (the call/ret overhead).
+ *      double access_time - the average time (ns) per block of calling the chain.
+ *      uint64_t rnd - the number of blocks in the chain.
+ */
+struct measurement measure_icache_latency(uint64_t repeat, uint64_t code_size, int random);
+
+#endif
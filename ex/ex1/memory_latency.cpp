@@ -2,8 +2,14 @@
 
 #include "memory_latency.h"
 #include "measure.h"
+#include "icache_latency.h"
+#include "smt_interference.h"
+#include "copy_bandwidth.h"
+#include "atomic_latency.h"
 #include <cmath>
 #include <iostream>
+#include <string>
+#include <thread>
 
 #define GALOIS_POLYNOMIAL ((1ULL << 63) | (1ULL << 62) | (1ULL << 60) | (1ULL << 59))
 
@@ -18,6 +24,26 @@ uint64_t nanosectime(struct timespec t)
 	return (uint64_t )t.tv_sec * pow(10,9) + (uint64_t )t.tv_nsec;
 }
 
+/**
+ * Fills a buffer with a single random cycle (Sattolo's algorithm), so following buf[i] visits every element.
+ * @param buf - the buffer to fill.
+ * @param buf_size - the length of buf.
+ */
+void init_chase(array_element_t* buf, uint64_t buf_size)
+{
+    for (uint64_t i = 0; i < buf_size; i++) {
+        buf[i] = i;
+    }
+    uint64_t rnd = 12345;
+    for (uint64_t i = buf_size - 1; i > 0; i--) {
+        rnd = (rnd >> 1) ^ ((0-(rnd & 1)) & GALOIS_POLYNOMIAL);
+        uint64_t j = rnd % i;
+        array_element_t tmp = buf[i];
+        buf[i] = buf[j];
+        buf[j] = tmp;
+    }
+}
+
 /**
 * Measures the average latency of accessing a given array in a sequential order.
 * @param repeat - the number of times to repeat the measurement for and average on.
@@ -73,16 +99,34 @@ struct measurement measure_sequential_latency(uint64_t repeat, array_element_t*
 /**
  * Runs the logic of the memory_latency program. Measures the access latency for random and sequential memory access
  * patterns.
- * Usage: './memory_latency max_size factor repeat' where:
+ * Usage: './memory_latency max_size factor repeat [mode [mode args]]' where:
  *      - max_size - the maximum size in bytes of the array to measure access latency for.
  *      - factor - the factor in the geometric series representing the array sizes to check.
  *      - repeat - the number of times each measurement should be repeated for and averaged on.
+ *      - mode - what to measure (default "data"):
+ *          - data - data access latency of an array of mem_size bytes.
+ *          - icache - cost per block of executing a generated chain of jumps whose code is mem_size bytes long.
+ *          - smt kernel [cpu sibling] - random access latency while the SMT sibling of cpu runs an interference kernel
+ *            (chase, stream or alu) over a max_size bytes buffer. cpu defaults to 0 and sibling to its hyperthread.
+ *          - memcpy [src_align dst_align [hot|cold]] - bandwidth of copies of mem_size bytes, starting from 8 bytes.
+ *            The source and destination start src_align and dst_align bytes after a page boundary (default 0), and
+ *            are either kept in cache (hot, the default) or flushed before every copy (cold).
+ *          - memset [dst_align [hot|cold]] - the same for filling mem_size bytes.
+ *          - atomic [local [cpu]|remote [cpu remote_cpu]] - latency of atomic operations on random lines of a mem_size
+ *            bytes buffer, from a thread pinned to cpu (default 0). With remote, a thread on remote_cpu (default 1)
+ *            writes every line before each pass, so the lines are modified by another core when the operations reach
+ *            them.
  * The program will print output to stdout in the following format:
  *      mem_size_1,offset_1,offset_sequential_1
  *      mem_size_2,offset_2,offset_sequential_2
  *              ...
  *              ...
  *              ...
+ * In smt mode each line is instead 'mem_size,offset_alone,offset_with_interference,slowdown'.
+ * In memcpy mode each line is 'mem_size,memcpy,rep_movsb,avx2,nt' and in memset mode 'mem_size,memset,rep_stosb,avx2,nt',
+ * where every column is the bandwidth in GB/s of that implementation (nan if the cpu does not support it).
+ * In atomic mode each line is 'mem_size,load,lock_xadd,lock_cmpxchg,xchg,mov_mfence' in ns per operation, where load is
+ * the latency of the plain pointer chase the operations are executed in.
  */
 int main(int argc, char* argv[])
 {
@@ -94,8 +138,10 @@ int main(int argc, char* argv[])
     // Your code here
 
     try {
-        if (argc != 4) {
-            std::cerr << "Usage: " << argv[0] << " max_size factor repeat\n";
+        if (argc < 4) {
+            std::cerr << "Usage: " << argv[0] << " max_size factor repeat "
+                      << "[data|icache|smt kernel [cpu sibling]|memcpy [src_align dst_align [hot|cold]]|"
+                      << "memset [dst_align [hot|cold]]|atomic [local [cpu]|remote [cpu remote_cpu]]]\n";
             return EXIT_FAILURE;
         }
 
@@ -113,10 +159,133 @@ int main(int argc, char* argv[])
         if (max_size <100){
             throw std::invalid_argument("max size must be bigger than 100");
         }
+        std::string mode = argc > 4 ? argv[4] : "data";
+        if ((mode == "data" || mode == "icache") && argc > 5) {
+            throw std::invalid_argument("too many arguments for mode " + mode);
+        }
+        if (mode == "icache" && max_size > INT32_MAX) {
+            // Every block jumps to the next one with a rel32 displacement, which cannot reach further
+            throw std::invalid_argument("max size must be at most " + std::to_string(INT32_MAX) + " in icache mode");
+        }
+
+        enum interference_kernel kernel = INTERFERENCE_ALU;
+        int cpu = 0;
+        int sibling = -1;
+        if (mode == "smt") {
+            if (argc != 6 && argc != 8) {
+                throw std::invalid_argument("smt mode takes a kernel and optionally cpu and sibling");
+            }
+            kernel = parse_interference_kernel(argv[5]);
+            if (argc == 8) {
+                cpu = std::stoi(argv[6]);
+                sibling = std::stoi(argv[7]);
+            } else {
+                sibling = find_smt_sibling(cpu);
+            }
+            if (sibling < 0) {
+                throw std::invalid_argument("cpu " + std::to_string(cpu) + " has no SMT sibling, pass cpu and sibling");
+            }
+        }
+
+        uint64_t src_align = 0;
+        uint64_t dst_align = 0;
+        enum copy_residency residency = COPY_HOT;
+        if (mode == "memcpy") {
+            if (argc != 5 && argc != 7 && argc != 8) {
+                throw std::invalid_argument("memcpy mode takes optionally src_align dst_align and residency");
+            }
+            if (argc >= 7) {
+                src_align = std::stoull(argv[5]) % 4096;
+                dst_align = std::stoull(argv[6]) % 4096;
+            }
+            if (argc == 8) {
+                residency = parse_copy_residency(argv[7]);
+            }
+        } else if (mode == "memset") {
+            if (argc > 7) {
+                throw std::invalid_argument("memset mode takes optionally dst_align and residency");
+            }
+            if (argc >= 6) {
+                dst_align = std::stoull(argv[5]) % 4096;
+            }
+            if (argc == 7) {
+                residency = parse_copy_residency(argv[6]);
+            }
+        }
+
+        int remote_cpu = -1;
+        if (mode == "atomic") {
+            if (argc > 8) {
+                throw std::invalid_argument("atomic mode takes optionally local or remote, and cpu and remote_cpu");
+            }
+            std::string state = argc >= 6 ? argv[5] : "local";
+            if (state == "local" && argc <= 7) {
+                cpu = argc == 7 ? std::stoi(argv[6]) : 0;
+                pin_to_cpu(cpu);
+            } else if (state == "remote" && argc != 7) {
+                cpu = argc == 8 ? std::stoi(argv[6]) : 0;
+                remote_cpu = argc == 8 ? std::stoi(argv[7]) : 1;
+                if (remote_cpu >= (int) std::thread::hardware_concurrency()) {
+                    throw std::invalid_argument("cpu " + std::to_string(remote_cpu) + " does not exist, pass cpu and remote_cpu");
+                }
+                if (remote_cpu == cpu) {
+                    throw std::invalid_argument("cpu and remote_cpu are both " + std::to_string(cpu)
+                                                + ", pass two different cpus");
+                }
+                pin_to_cpu(cpu);
+            } else if (state == "local" || state == "remote") {
+                throw std::invalid_argument("atomic mode takes cpu after local, and cpu and remote_cpu after remote");
+            } else {
+                throw std::invalid_argument("unknown line state " + state);
+            }
+        } else if (mode != "data" && mode != "icache" && mode != "smt" && mode != "memcpy" && mode != "memset") {
+            throw std::invalid_argument("unknown mode " + mode);
+        }
 
         uint64_t i=MIN_SIZE;
+        if (mode == "memcpy" || mode == "memset") {
+            i = COPY_MIN_SIZE;
+        }
         while (i<max_size){
 
+            if (mode == "atomic") {
+                std::cout << i;
+                for (int op = 0; op < ATOMIC_OP_COUNT; op++) {
+                    struct measurement result = measure_atomic_latency(repeat, i, (enum atomic_op) op, zero, remote_cpu);
+                    std::cout << "," << result.access_time - result.baseline;
+                }
+                std::cout << std::endl;
+
+                i = (uint64_t) ceil(i * factor);
+                continue;
+            }
+
+            if (mode == "memcpy" || mode == "memset") {
+                const struct copy_implementation* impls =
+                        mode == "memcpy" ? memcpy_implementations : memset_implementations;
+                int count = mode == "memcpy" ? memcpy_implementations_count : memset_implementations_count;
+
+                std::cout << i;
+                for (int k = 0; k < count; k++) {
+                    std::cout << "," << measure_copy_bandwidth(&impls[k], repeat, i, src_align, dst_align, residency);
+                }
+                std::cout << std::endl;
+
+                i = (uint64_t) ceil(i * factor);
+                continue;
+            }
+
+            if (mode == "icache") {
+                struct measurement sequential_result = measure_icache_latency(repeat, i, 0);
+                struct measurement random_result = measure_icache_latency(repeat, i, 1);
+
+                std::cout << i << "," << random_result.access_time - random_result.baseline
+                          << "," << sequential_result.access_time - sequential_result.baseline << std::endl;
+
+                i = (uint64_t) ceil(i * factor);
+                continue;
+            }
+
             uint64_t * arr = (uint64_t *) malloc(i);
 
             for (uint64_t j=0; j<(i/ sizeof(uint64_t) ); j++)
@@ -125,6 +294,21 @@ int main(int argc, char* argv[])
             }
 
 
+            if (mode == "smt") {
+                pin_to_cpu(cpu);
+                struct measurement alone_result = measure_latency(repeat, arr, i/(sizeof (uint64_t)), zero);
+                struct measurement shared_result = measure_latency_with_interference(
+                        repeat, arr, i/(sizeof (uint64_t)), zero, cpu, sibling, kernel, max_size);
+                double alone = alone_result.access_time - alone_result.baseline;
+                double shared = shared_result.access_time - shared_result.baseline;
+
+                std::cout << i << "," << alone << "," << shared << "," << shared / alone << std::endl;
+
+                free(arr);
+                i = (uint64_t) ceil(i * factor);
+                continue;
+            }
+
             struct measurement sequential_result =
                     measure_sequential_latency(repeat, arr, i/ (sizeof(uint64_t )), zero);
             struct measurement random_result =
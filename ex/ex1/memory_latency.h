@@ -29,6 +29,14 @@ struct measurement {
 uint64_t nanosectime(struct timespec t);
 
 
+/**
+ * Fills a buffer with a single random cycle (Sattolo's algorithm), so following buf[i] visits every element.
+ * @param buf - the buffer to fill.
+ * @param buf_size - the length of buf.
+ */
+void init_chase(array_element_t* buf, uint64_t buf_size);
+
+
 /**
 * Measures the average latency of accessing a given array in a sequential order.
 * @param repeat - the number of times to repeat the measurement for and average on.
@@ -0,0 +1,142 @@
+// OS 2025 EX1
+
+#include "smt_interference.h"
+#include "measure.h"
+#include <pthread.h>
+#include <sched.h>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#define GALOIS_POLYNOMIAL ((1ULL << 63) | (1ULL << 62) | (1ULL << 60) | (1ULL << 59))
+
+enum interference_kernel parse_interference_kernel(const char* name)
+{
+    if (strcmp(name, "chase") == 0) {
+        return INTERFERENCE_CHASE;
+    }
+    if (strcmp(name, "stream") == 0) {
+        return INTERFERENCE_STREAM;
+    }
+    if (strcmp(name, "alu") == 0) {
+        return INTERFERENCE_ALU;
+    }
+    throw std::invalid_argument(std::string("unknown interference kernel ") + name);
+}
+
+int find_smt_sibling(int cpu)
+{
+    std::ifstream siblings_file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list");
+    std::string list;
+    if (!std::getline(siblings_file, list)) {
+        return -1;
+    }
+
+    // The list looks like "0,4" or "0-1" (possibly with more than two entries).
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int sibling = first; sibling <= last; sibling++) {
+            if (sibling != cpu) {
+                return sibling;
+            }
+        }
+    }
+    return -1;
+}
+
+void pin_to_cpu(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        throw std::runtime_error("cannot pin thread to cpu " + std::to_string(cpu));
+    }
+}
+
+/**
+ * Runs an interference kernel until stop is set.
+ * @param kernel - the kernel to run.
+ * @param buf - the buffer the chase and stream kernels work on.
+ * @param buf_size - the length of buf.
+ * @param started - set once the kernel is running.
+ * @param stop - the kernel returns once this is set.
+ * @return a value depending on everything the kernel computed, to prevent compiler optimizations.
+ */
+static uint64_t run_interference(enum interference_kernel kernel, array_element_t* buf, uint64_t buf_size,
+                                 std::atomic<bool>* started, std::atomic<bool>* stop)
+{
+    register uint64_t rnd = 12345;
+    register uint64_t index = 0;
+    started->store(true);
+    while (!stop->load(std::memory_order_relaxed)) {
+        for (register uint64_t i = 0; i < 1024; i++) {
+            switch (kernel) {
+                case INTERFERENCE_CHASE:
+                    index = buf[index];
+                    break;
+                case INTERFERENCE_STREAM:
+                    buf[index] += rnd;
+                    index = index + 1 == buf_size ? 0 : index + 1;
+                    break;
+                case INTERFERENCE_ALU:
+                    break;
+            }
+            rnd = (rnd >> 1) ^ ((0-(rnd & 1)) & GALOIS_POLYNOMIAL);  // Advance rnd pseudo-randomly (using Galois LFSR)
+        }
+    }
+    return rnd ^ index;
+}
+
+struct measurement measure_latency_with_interference(uint64_t repeat, array_element_t* arr, uint64_t arr_size,
+                                                     uint64_t zero, int cpu, int sibling,
+                                                     enum interference_kernel kernel, uint64_t interference_size)
+{
+    uint64_t buf_size = interference_size / sizeof(array_element_t);
+    buf_size = buf_size == 0 ? 1 : buf_size;
+    array_element_t* buf = (array_element_t*) malloc(buf_size * sizeof(array_element_t));
+    if (buf == NULL) {
+        throw std::runtime_error("cannot allocate the interference buffer");
+    }
+    init_chase(buf, buf_size);
+
+    std::atomic<bool> started(false);
+    std::atomic<bool> stop(false);
+    std::atomic<bool> pinned(true);
+    std::atomic<uint64_t> sink(0);
+    std::thread interferer([&]() {
+        try {
+            pin_to_cpu(sibling);
+        } catch (const std::exception&) {
+            pinned = false;
+            started = true;
+            return;
+        }
+        sink = run_interference(kernel, buf, buf_size, &started, &stop);
+    });
+
+    pin_to_cpu(cpu);
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+    if (!pinned.load()) {
+        interferer.join();
+        free(buf);
+        throw std::runtime_error("cannot pin thread to cpu " + std::to_string(sibling));
+    }
+    struct measurement result = measure_latency(repeat, arr, arr_size, zero);
+    stop.store(true);
+    interferer.join();
+    free(buf);
+
+    result.rnd ^= sink.load() & zero;
+    return result;
+}
@@ -0,0 +1,59 @@
+// OS 2025 EX1
+
+#ifndef _SMT_INTERFERENCE_H
+#define _SMT_INTERFERENCE_H
+
+#include "memory_latency.h"
+
+/**
+ * The kernels that can run on the sibling hyperthread while the latency is measured.
+ */
+enum interference_kernel {
+    INTERFERENCE_CHASE,   // dependent loads over a random cyclic permutation (latency bound)
+    INTERFERENCE_STREAM,  // sequential read-modify-write over a buffer (bandwidth bound)
+    INTERFERENCE_ALU      // register only arithmetic, no memory accesses
+};
+
+
+/**
+ * Parses the name of an interference kernel ("chase", "stream" or "alu").
+ * @param name - the name to parse.
+ * @return the matching kernel. Throws std::invalid_argument for an unknown name.
+ */
+enum interference_kernel parse_interference_kernel(const char* name);
+
+
+/**
+ * Finds an SMT sibling (another hyperthread of the same physical core) of a given cpu.
+ * @param cpu - the cpu to find a sibling of.
+ * @return the number of the sibling cpu, or -1 if the cpu has no sibling (or the topology cannot be read).
+ */
+int find_smt_sibling(int cpu);
+
+
+/**
+ * Measures the average latency of accessing a given array (like measure_latency) from one cpu while another cpu runs
+ * an interference kernel. Both threads are pinned for the duration of the measurement.
+ * @param repeat - the number of times to repeat the measurement for and average on.
+ * @param arr - an allocated (not empty) array to preform measurement on.
+ * @param arr_size - the length of the array arr.
+ * @param zero - a variable containing zero in a way that the compiler doesn't "know" it in compilation time.
+ * @param cpu - the cpu to measure on.
+ * @param sibling - the cpu to run the interference kernel on.
+ * @param kernel - the interference kernel to run.
+ * @param interference_size - the size in bytes of the buffer the chase and stream kernels work on.
+ * @return struct measurement as returned by measure_latency.
+ */
+struct measurement measure_latency_with_interference(uint64_t repeat, array_element_t* arr, uint64_t arr_size,
+                                                     uint64_t zero, int cpu, int sibling,
+                                                     enum interference_kernel kernel, uint64_t interference_size);
+
+
+/**
+ * Pins the calling thread to a single cpu.
+ * @param cpu - the cpu to pin to.
+ * Throws std::runtime_error if the affinity cannot be set.
+ */
+void pin_to_cpu(int cpu);
+
+#endif
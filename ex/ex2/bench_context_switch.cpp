@@ -0,0 +1,95 @@
+/*
+ * bench_context_switch.cpp - Switches per second of sigsetjmp/siglongjmp (the old uthreads switch path, which saves
+ * and restores the signal mask on every switch) against context_switch.
+ *
+ * Usage: ./bench_context_switch [round_trips]
+ * Two contexts ping-pong round_trips times (default 1000000), so each variant makes 2 * round_trips switches.
+ */
+
+#include <csetjmp>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include "context_switch.h"
+
+#define BENCH_STACK_SIZE 65536
+#define DEFAULT_ROUND_TRIPS 1000000
+
+typedef unsigned long address_t;
+#define JB_SP 6
+#define JB_PC 7
+
+address_t translate_address(address_t addr) {
+    address_t ret;
+    asm volatile("xor    %%fs:0x30,%0\n"
+                 "rol    $0x11,%0\n"
+                 : "=g" (ret)
+                 : "0" (addr));
+    return ret;
+}
+
+static sigjmp_buf main_env, partner_env;
+static thread_context main_context, partner_context;
+static char sigjmp_stack[BENCH_STACK_SIZE];
+static char switch_stack[BENCH_STACK_SIZE];
+
+static void sigjmp_partner() {
+    while (true) {
+        if (sigsetjmp(partner_env, 1) == 0) {
+            siglongjmp(main_env, 1);
+        }
+    }
+}
+
+static void switch_partner(void*) {
+    while (true) {
+        context_switch(&partner_context, &main_context);
+    }
+}
+
+static double now_seconds() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void report(const char* name, long switches, double seconds) {
+    printf("%-22s %12.0f switches/s %8.1f ns/switch\n", name, switches / seconds, seconds * 1e9 / switches);
+}
+
+int main(int argc, char** argv) {
+    long round_trips = argc > 1 ? atol(argv[1]) : DEFAULT_ROUND_TRIPS;
+    if (round_trips <= 0) {
+        fprintf(stderr, "usage: %s [round_trips]\n", argv[0]);
+        return 1;
+    }
+
+    // The partner starts on its own stack, the same way the old Thread constructor set it up
+    sigsetjmp(partner_env, 1);
+    partner_env->__jmpbuf[JB_SP] = translate_address((address_t) sigjmp_stack + BENCH_STACK_SIZE - sizeof(address_t));
+    partner_env->__jmpbuf[JB_PC] = translate_address((address_t) sigjmp_partner);
+    sigemptyset(&partner_env->__saved_mask);
+
+    double start = now_seconds();
+    static long i; // static, so its value survives the siglongjmp back into this frame
+    for (i = 0; i < round_trips; i++) {
+        if (sigsetjmp(main_env, 1) == 0) {
+            siglongjmp(partner_env, 1);
+        }
+    }
+    double sigjmp_seconds = now_seconds() - start;
+
+    context_init(&partner_context, switch_stack, BENCH_STACK_SIZE, &switch_partner, nullptr);
+    start = now_seconds();
+    for (long i = 0; i < round_trips; i++) {
+        context_switch(&main_context, &partner_context);
+    }
+    double switch_seconds = now_seconds() - start;
+
+    report("sigsetjmp/siglongjmp", 2 * round_trips, sigjmp_seconds);
+    report("context_switch", 2 * round_trips, switch_seconds);
+    printf("speedup: %.1fx\n", sigjmp_seconds / switch_seconds);
+    return 0;
+}
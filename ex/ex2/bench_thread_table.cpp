@@ -0,0 +1,163 @@
+/*
+ * bench_thread_table.cpp - Spawns, runs and terminates many uthreads at once and reports the memory each thread
+ * takes and the spawn and terminate throughput.
+ *
+ * Usage: ./bench_thread_table [threads]
+ * threads (default 100000) uthreads are spawned by the main thread and then run in one round: each one counts itself
+ * and returns, which terminates it. Then the same number is spawned again into the freed slots and terminated by the
+ * main thread without ever running, once with uthread_spawn and once with uthread_spawn_many. Last, threads are
+ * spawned in batches of CHURN_BATCH with uthread_spawn_many and run to their end, like a server that spawns a thread
+ * per request, and the heap allocations made in that steady state are counted.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include <unistd.h>
+
+#include "uthreads.h"
+
+#define DEFAULT_THREADS 100000
+#define BENCH_QUANTUM_USECS 100000000 /* long enough for the timer never to fire during the benchmark */
+#define CHURN_BATCH 256
+
+static volatile long finished = 0;
+static int* tids;
+static long allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+static void worker() {
+    finished = finished + 1;
+}
+
+static void spin() {
+    while (true) {}
+}
+
+static double now_seconds() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/*
+ * The resident set size of the process in bytes.
+ */
+static long resident_bytes() {
+    long size, resident;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == nullptr || fscanf(statm, "%ld %ld", &size, &resident) != 2) {
+        fprintf(stderr, "cannot read /proc/self/statm\n");
+        exit(1);
+    }
+    fclose(statm);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static void report(const char* name, long count, double seconds) {
+    printf("%-28s %12.0f threads/s %8.1f ns/thread\n", name, count / seconds, seconds * 1e9 / count);
+}
+
+int main(int argc, char** argv) {
+    int threads = argc > 1 ? atoi(argv[1]) : DEFAULT_THREADS;
+    if (threads <= 0) {
+        fprintf(stderr, "usage: %s [threads]\n", argv[0]);
+        return 1;
+    }
+    tids = new int[threads];
+    if (uthread_init(BENCH_QUANTUM_USECS, threads + 1) != 0) {
+        return 1;
+    }
+
+    long resident_before = resident_bytes();
+    double start = now_seconds();
+    for (int i = 0; i < threads; i++) {
+        tids[i] = uthread_spawn(worker);
+    }
+    double spawn_seconds = now_seconds() - start;
+    long resident_after = resident_bytes();
+
+    // Every worker runs once and terminates itself before the main thread gets the CPU back
+    start = now_seconds();
+    uthread_yield();
+    double exit_seconds = now_seconds() - start;
+    if (finished != threads) {
+        fprintf(stderr, "only %ld of %d threads finished\n", finished, threads);
+        return 1;
+    }
+
+    start = now_seconds();
+    for (int i = 0; i < threads; i++) {
+        tids[i] = uthread_spawn(spin);
+    }
+    double respawn_seconds = now_seconds() - start;
+    start = now_seconds();
+    for (int i = 0; i < threads; i++) {
+        uthread_terminate(tids[i]);
+    }
+    double terminate_seconds = now_seconds() - start;
+
+    thread_entry_point* entries = new thread_entry_point[threads];
+    for (int i = 0; i < threads; i++) {
+        entries[i] = spin;
+    }
+    start = now_seconds();
+    uthread_spawn_many(entries, threads, tids);
+    double spawn_many_seconds = now_seconds() - start;
+    for (int i = 0; i < threads; i++) {
+        uthread_terminate(tids[i]);
+    }
+
+    // One round first, so the stacks and slots the batches take are there already
+    int batch = threads < CHURN_BATCH ? threads : CHURN_BATCH;
+    int rounds = threads / batch;
+    for (int i = 0; i < batch; i++) {
+        entries[i] = worker;
+    }
+    uthread_spawn_many(entries, batch, nullptr);
+    uthread_yield();
+    finished = 0;
+    long allocations_before = allocations;
+    start = now_seconds();
+    for (int round = 0; round < rounds; round++) {
+        uthread_spawn_many(entries, batch, nullptr);
+        uthread_yield();
+    }
+    double churn_seconds = now_seconds() - start;
+    long churn_allocations = allocations - allocations_before;
+    if (finished != (long) rounds * batch) {
+        fprintf(stderr, "only %ld of %ld churned threads finished\n", finished, (long) rounds * batch);
+        return 1;
+    }
+
+    printf("threads: %d, stack: %d bytes, memory: %.0f bytes/thread\n", threads, STACK_SIZE,
+           (double) (resident_after - resident_before) / threads);
+    report("spawn", threads, spawn_seconds);
+    report("run and exit", threads, exit_seconds);
+    report("spawn into freed slots", threads, respawn_seconds);
+    report("terminate (never ran)", threads, terminate_seconds);
+    report("spawn_many into freed slots", threads, spawn_many_seconds);
+    report("spawn_many, run and exit", (long) rounds * batch, churn_seconds);
+    printf("heap allocations in %d batches of %d: %ld\n", rounds, batch, churn_allocations);
+    delete[] entries;
+    delete[] tids;
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef CARRIER_H
+#define CARRIER_H
+
+#include <csignal>
+#include <ctime>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "context_switch.h"
+#include "run_queue.h"
+#include "stack_pool.h"
+#include "work_stealing_deque.h"
+
+class Thread;
+
+/*
+ * A kernel thread that runs uthreads. There is one carrier per kernel thread given to uthread_init; carrier 0 is the
+ * thread that called uthread_init.
+ */
+struct Carrier {
+    int index;
+    pthread_t pthread;
+    pid_t tid;
+
+    // the carrier's READY threads. Threads sent here by other carriers (through an affinity hint) wait in the inbox,
+    // which is guarded by the scheduler lock, since only the owner may push to the deque
+    WorkStealingDeque deque;
+    RunQueue inbox;
+
+    // a thread that was switched away from on this carrier; it is marked off the CPU by whatever runs next here, once
+    // its context is saved
+    Thread* prev;
+
+    // a thread that terminated itself, destroyed by whatever runs next here, once it is off its stack
+    Thread* pending_delete;
+
+    // the context that runs on this carrier when it has no thread to run: it steals, and sleeps when nothing is found
+    thread_context idle_context;
+    Stack idle_stack;
+
+    // the preemption timer, which measures the CPU time of this carrier only
+    timer_t timer;
+
+    // set by a tick that came in while the running thread had preemption disabled
+    volatile sig_atomic_t preempt_pending;
+};
+
+#endif // CARRIER_H
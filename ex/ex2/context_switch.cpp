@@ -0,0 +1,80 @@
+#include "context_switch.h"
+#include <cstdint>
+#include <cstring>
+
+#ifndef __x86_64__
+#error "context_switch is implemented for x86-64 only"
+#endif
+
+#define INITIAL_MXCSR 0x1F80     /* all SSE exceptions masked, round to nearest */
+#define INITIAL_FPU_CW 0x037F    /* all x87 exceptions masked, double extended precision, round to nearest */
+#define STACK_ALIGNMENT 16
+
+/*
+ * Layout of a suspended context, from the saved stack pointer upwards. context_init builds the same layout by hand.
+ */
+struct switch_frame {
+    uint32_t mxcsr;
+    uint16_t fpu_cw;
+    uint16_t padding;
+    uint64_t r15;
+    uint64_t r14;
+    uint64_t r13;
+    uint64_t r12;
+    uint64_t rbx;
+    uint64_t rbp;
+    uint64_t return_address;
+};
+
+extern "C" void context_start();
+
+asm(R"(
+    .text
+    .globl context_switch
+    .type context_switch, @function
+context_switch:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq (%rsi), %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size context_switch, .-context_switch
+
+    .type context_start, @function
+context_start:
+    movq %r13, %rdi
+    callq *%r12
+    ud2
+    .size context_start, .-context_start
+)");
+
+void context_init(thread_context* ctx, char* stack, size_t stack_size, context_entry_point entry, void* arg) {
+    uintptr_t top = ((uintptr_t) stack + stack_size) & ~(uintptr_t) (STACK_ALIGNMENT - 1);
+
+    // context_start is entered by 'ret', so the stack pointer it sees is 16 byte aligned, as 'call' expects.
+    uintptr_t frame_address = top - STACK_ALIGNMENT - sizeof(switch_frame);
+    auto* frame = (switch_frame*) frame_address;
+    memset(frame, 0, sizeof(switch_frame));
+    frame->mxcsr = INITIAL_MXCSR;
+    frame->fpu_cw = INITIAL_FPU_CW;
+    frame->r12 = (uint64_t) entry;
+    frame->r13 = (uint64_t) arg;
+    frame->return_address = (uint64_t) &context_start;
+    ctx->sp = frame;
+}
@@ -0,0 +1,33 @@
+#ifndef CONTEXT_SWITCH_H
+#define CONTEXT_SWITCH_H
+
+#include <cstddef>
+
+/*
+ * The saved execution state of a thread that is not running.
+ * Everything else (callee-saved registers, the MXCSR and the x87 control word) is pushed on the thread's own stack by
+ * context_switch, so the context is just the stack pointer.
+ */
+struct thread_context {
+    void* sp;
+};
+
+typedef void (*context_entry_point)(void* arg);
+
+/**
+ * @brief Saves the current execution state into from and resumes the state saved in to.
+ *
+ * Only what the x86-64 SysV ABI requires a callee to preserve is saved: rbx, rbp, r12-r15, the stack pointer and the
+ * floating point control words. The signal mask is not touched, so no system call is made.
+ * The call returns when another context_switch resumes from.
+*/
+extern "C" void context_switch(thread_context* from, thread_context* to);
+
+/**
+ * @brief Prepares a context that starts running entry(arg) on the given stack the first time it is switched to.
+ *
+ * entry must never return.
+*/
+void context_init(thread_context* ctx, char* stack, size_t stack_size, context_entry_point entry, void* arg);
+
+#endif // CONTEXT_SWITCH_H
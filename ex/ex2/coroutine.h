@@ -0,0 +1,372 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <exception>
+#include <optional>
+#include <sys/epoll.h>
+#include <utility>
+
+#include "uthreads.h"
+#include "waiter.h"
+
+/*
+ * Stackless coroutines that the uthread scheduler runs alongside the stackful threads.
+ *
+ * A uthread::task<T> is a coroutine that returns a T; it starts when it is co_awaited, or when it is handed to
+ * uthread::spawn. The spawned coroutines are resumed by a thread the library spawns for them with the first spawn
+ * (the coroutine runner), one at a time and in the order they became ready, each until it suspends again. A coroutine
+ * that waits is no thread: it waits, through the Waiter in its frame, in the same wait queues, deadline heap and
+ * reactor the threads wait in, so a pending operation costs the few hundred bytes of its frame instead of a stack.
+ *
+ * A coroutine waits by co_awaiting a task or one of the awaitables below. Every other call of the library that may
+ * wait (uthread_sleep, uthread_channel_send, uthread_read...) parks the coroutine runner, and with it every coroutine.
+ * A coroutine must not be destroyed while it waits.
+ */
+
+/* Defined by the thread library for the awaitables below. Each takes the scheduler lock itself. */
+
+/* Queues a spawned coroutine's start waiter for the coroutine runner, spawning the runner with the first call.
+ * Returns 0 on success, or -1 if the runner cannot be spawned. */
+int coroutine_spawn(Waiter* start);
+
+/* Queues waiter for the coroutine runner again, after the coroutines that are ready already. */
+void coroutine_yield(Waiter* waiter);
+
+/* Puts waiter in the deadline heap until deadline_nsecs. Returns false, without waiting, if it has passed. */
+bool coroutine_sleep(Waiter* waiter, uint64_t deadline_nsecs);
+
+/* Receives from channel into *value like uthread_channel_receive, or returns -1 after queueing waiter, which gets the
+ * result and value like a thread would. */
+int coroutine_receive(uthread_channel* channel, Waiter* waiter, void** value);
+
+/* Queues waiter until fd is ready for direction (EPOLLIN or EPOLLOUT). Returns 0, or -1 with errno set if fd cannot be
+ * waited on. */
+int coroutine_wait_fd(int fd, uint32_t direction, Waiter* waiter);
+
+/* Allocate and free a coroutine frame, and destroy a coroutine, with preemption disabled: the allocator is not safe
+ * against another thread running on the same carrier in the middle of a call. coroutine_frame_alloc throws
+ * std::bad_alloc. */
+void* coroutine_frame_alloc(size_t size);
+void coroutine_frame_free(void* frame);
+void coroutine_destroy(std::coroutine_handle<> coroutine);
+
+namespace uthread {
+
+template <typename T = void>
+class task;
+
+namespace detail {
+
+/*
+ * What the promises of all tasks share: the coroutine that awaits the task, which the task resumes when it ends, and
+ * the exception it ended with. A spawned task has no awaiting coroutine, and destroys its own frame when it ends.
+ */
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+    bool detached = false;
+    Waiter start;
+
+    static void* operator new(size_t size) {
+        return coroutine_frame_alloc(size);
+    }
+
+    static void operator delete(void* frame) noexcept {
+        coroutine_frame_free(frame);
+    }
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> coroutine) noexcept {
+            PromiseBase& promise = coroutine.promise();
+            if (promise.continuation) {
+                return promise.continuation;
+            }
+            if (promise.detached) {
+                // Nobody could catch it
+                if (promise.exception) {
+                    std::terminate();
+                }
+                coroutine_destroy(coroutine);
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() const noexcept {
+        return {};
+    }
+
+    void unhandled_exception() noexcept {
+        exception = std::current_exception();
+    }
+
+    void rethrow() const {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    std::optional<T> value;
+
+    task<T> get_return_object() noexcept;
+
+    template <typename U>
+    void return_value(U&& result) {
+        value.emplace(std::forward<U>(result));
+    }
+
+    T take() {
+        rethrow();
+        return std::move(*value);
+    }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    task<void> get_return_object() noexcept;
+
+    void return_void() const noexcept {}
+
+    void take() const {
+        rethrow();
+    }
+};
+
+} // namespace detail
+
+/*
+ * A coroutine returning a T. Awaiting it starts it, suspends the awaiting coroutine until it ends, and gives its result
+ * (or throws the exception it ended with). The task owns the coroutine's frame.
+ */
+template <typename T>
+class task {
+public:
+    using promise_type = detail::Promise<T>;
+
+    task(task&& other) noexcept : coroutine(std::exchange(other.coroutine, nullptr)) {}
+
+    task& operator=(task&& other) noexcept {
+        if (this != &other) {
+            if (coroutine) {
+                coroutine_destroy(coroutine);
+            }
+            coroutine = std::exchange(other.coroutine, nullptr);
+        }
+        return *this;
+    }
+
+    ~task() {
+        if (coroutine) {
+            coroutine_destroy(coroutine);
+        }
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    // Symmetric transfer: the awaiting coroutine's resume runs this one, without growing the runner's stack
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        coroutine.promise().continuation = awaiting;
+        return coroutine;
+    }
+
+    T await_resume() {
+        return coroutine.promise().take();
+    }
+
+private:
+    explicit task(std::coroutine_handle<promise_type> coroutine) : coroutine(coroutine) {}
+
+    friend promise_type;
+    friend int spawn(task<void> work);
+
+    std::coroutine_handle<promise_type> coroutine;
+};
+
+namespace detail {
+
+template <typename T>
+task<T> Promise<T>::get_return_object() noexcept {
+    return task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline task<void> Promise<void>::get_return_object() noexcept {
+    return task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+} // namespace detail
+
+/*
+ * Hands work to the coroutine runner, which starts it after the coroutines that are ready already. The coroutine's
+ * frame is destroyed when it ends; an exception it ends with terminates the process.
+ *
+ * @return On success, return 0. On failure, return -1 (and work is destroyed).
+ */
+inline int spawn(task<void> work) {
+    auto coroutine = std::exchange(work.coroutine, nullptr);
+    coroutine.promise().detached = true;
+    coroutine.promise().start.coroutine = coroutine;
+    if (coroutine_spawn(&coroutine.promise().start) < 0) {
+        coroutine_destroy(coroutine);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Resumes the coroutine after the coroutines that are ready already.
+ */
+class YieldAwaiter {
+public:
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> coroutine) {
+        waiter.coroutine = coroutine;
+        coroutine_yield(&waiter);
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    Waiter waiter;
+};
+
+inline YieldAwaiter yield() {
+    return {};
+}
+
+/*
+ * Resumes the coroutine once the CLOCK_MONOTONIC time is deadline_nsecs, or right away if it has passed.
+ */
+class SleepAwaiter {
+public:
+    explicit SleepAwaiter(uint64_t deadline_nsecs) : deadline_nsecs(deadline_nsecs) {}
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> coroutine) {
+        waiter.coroutine = coroutine;
+        return coroutine_sleep(&waiter, deadline_nsecs);
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    uint64_t deadline_nsecs;
+    Waiter waiter;
+};
+
+inline SleepAwaiter sleep_until(uint64_t deadline_nsecs) {
+    return SleepAwaiter(deadline_nsecs);
+}
+
+inline SleepAwaiter sleep_for(uint64_t nsecs) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return SleepAwaiter(now.tv_sec * 1000000000ULL + now.tv_nsec + nsecs);
+}
+
+/*
+ * Receives the oldest value on channel into *value, suspending the coroutine while the channel is empty. Gives what
+ * uthread_channel_receive returns: 0 on success, 1 if the channel is closed and every value sent was received.
+ */
+class ReceiveAwaiter {
+public:
+    ReceiveAwaiter(uthread_channel* channel, void** value) : channel(channel), value(value), result(0) {}
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> coroutine) {
+        waiter.coroutine = coroutine;
+        result = coroutine_receive(channel, &waiter, value);
+        return result < 0;
+    }
+
+    int await_resume() {
+        if (result < 0) {
+            // A sender left the value in transfer, or close ended the wait
+            result = waiter.wait_result;
+            if (result == 0) {
+                *value = waiter.transfer;
+            }
+        }
+        return result;
+    }
+
+private:
+    uthread_channel* channel;
+    void** value;
+    int result;
+    Waiter waiter;
+};
+
+inline ReceiveAwaiter receive(uthread_channel* channel, void** value) {
+    return ReceiveAwaiter(channel, value);
+}
+
+/*
+ * Suspends the coroutine until fd is ready for direction (EPOLLIN or EPOLLOUT), or reports an error or a hang-up.
+ * Gives 0 then, or -1 with errno set if fd cannot be waited on. fd should be non-blocking, so the call that follows
+ * fails with EAGAIN rather than blocking the runner if another coroutine took what was ready.
+ */
+class FdAwaiter {
+public:
+    FdAwaiter(int fd, uint32_t direction) : fd(fd), direction(direction), result(0) {}
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> coroutine) {
+        waiter.coroutine = coroutine;
+        result = coroutine_wait_fd(fd, direction, &waiter);
+        return result == 0;
+    }
+
+    int await_resume() const noexcept {
+        return result;
+    }
+
+private:
+    int fd;
+    uint32_t direction;
+    int result;
+    Waiter waiter;
+};
+
+inline FdAwaiter readable(int fd) {
+    return FdAwaiter(fd, EPOLLIN);
+}
+
+inline FdAwaiter writable(int fd) {
+    return FdAwaiter(fd, EPOLLOUT);
+}
+
+} // namespace uthread
+
+#endif // COROUTINE_H
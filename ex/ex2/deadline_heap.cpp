@@ -0,0 +1,85 @@
+#include "deadline_heap.h"
+
+#include "waiter.h"
+
+void DeadlineHeap::reserve(size_t capacity) {
+    heap.reserve(capacity);
+}
+
+bool DeadlineHeap::empty() const {
+    return heap.empty();
+}
+
+uint64_t DeadlineHeap::next_deadline() const {
+    return heap.front() -> wake_nsecs;
+}
+
+void DeadlineHeap::insert(Waiter* waiter, uint64_t deadline) {
+    waiter -> wake_nsecs = deadline;
+    heap.push_back(waiter);
+    sift_up(heap.size() - 1);
+}
+
+bool DeadlineHeap::contains(const Waiter* waiter) const {
+    size_t index = waiter -> deadline_index;
+    return index < heap.size() && heap[index] == waiter;
+}
+
+void DeadlineHeap::remove(Waiter* waiter) {
+    if (!contains(waiter)) {
+        return;
+    }
+    size_t index = waiter -> deadline_index;
+    Waiter* last = heap.back();
+    heap.pop_back();
+    if (last != waiter) {
+        place(index, last);
+        sift_up(index);
+        sift_down(last -> deadline_index);
+    }
+}
+
+void DeadlineHeap::expire(uint64_t now, deadline_expire_fn expire) {
+    while (!heap.empty() && heap.front() -> wake_nsecs <= now) {
+        Waiter* waiter = heap.front();
+        remove(waiter);
+        expire(waiter);
+    }
+}
+
+void DeadlineHeap::place(size_t index, Waiter* waiter) {
+    heap[index] = waiter;
+    waiter -> deadline_index = index;
+}
+
+void DeadlineHeap::sift_up(size_t index) {
+    Waiter* waiter = heap[index];
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (heap[parent] -> wake_nsecs <= waiter -> wake_nsecs) {
+            break;
+        }
+        place(index, heap[parent]);
+        index = parent;
+    }
+    place(index, waiter);
+}
+
+void DeadlineHeap::sift_down(size_t index) {
+    Waiter* waiter = heap[index];
+    while (true) {
+        size_t child = 2 * index + 1;
+        if (child >= heap.size()) {
+            break;
+        }
+        if (child + 1 < heap.size() && heap[child + 1] -> wake_nsecs < heap[child] -> wake_nsecs) {
+            child++;
+        }
+        if (heap[child] -> wake_nsecs >= waiter -> wake_nsecs) {
+            break;
+        }
+        place(index, heap[child]);
+        index = child;
+    }
+    place(index, waiter);
+}
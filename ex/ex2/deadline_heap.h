@@ -0,0 +1,49 @@
+#ifndef DEADLINE_HEAP_H
+#define DEADLINE_HEAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Waiter;
+
+typedef void (*deadline_expire_fn)(Waiter* waiter);
+
+/*
+ * Threads (and coroutines) sleeping until an absolute CLOCK_MONOTONIC deadline, in nanoseconds.
+ *
+ * A binary min-heap on the deadline, whose positions are stored in Waiter::deadline_index, so insert and remove are
+ * O(log n) and the earliest deadline is O(1). Once reserve has made room for every thread, nothing is allocated but
+ * for the sleeping coroutines.
+ */
+class DeadlineHeap {
+public:
+    /* Makes room for capacity threads. */
+    void reserve(size_t capacity);
+
+    bool empty() const;
+
+    /* The earliest deadline. The heap must not be empty. */
+    uint64_t next_deadline() const;
+
+    /* Adds waiter, to expire at deadline. */
+    void insert(Waiter* waiter, uint64_t deadline);
+
+    /* Removes waiter from the heap, if it is in it. */
+    void remove(Waiter* waiter);
+
+    /* Whether waiter is in the heap. */
+    bool contains(const Waiter* waiter) const;
+
+    /* Calls expire for every waiter whose deadline is at or before now, after removing it from the heap. */
+    void expire(uint64_t now, deadline_expire_fn expire);
+
+private:
+    void place(size_t index, Waiter* waiter);
+    void sift_up(size_t index);
+    void sift_down(size_t index);
+
+    std::vector<Waiter*> heap;
+};
+
+#endif // DEADLINE_HEAP_H
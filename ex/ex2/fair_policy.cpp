@@ -0,0 +1,152 @@
+#include "fair_policy.h"
+
+#include <algorithm>
+#include <ctime>
+
+#include "thread.h"
+
+#define NANOS_PER_SECOND 1000000000ULL
+
+static uint64_t now_nsecs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NANOS_PER_SECOND + now.tv_nsec;
+}
+
+FairPolicy::FairPolicy() : running(nullptr), charged_at(0), min_vruntime(0), wake_credit(0), sequence(0) {}
+
+bool FairPolicy::empty() const {
+    return heap.empty();
+}
+
+void FairPolicy::enqueue(Thread* thread) {
+    if (thread == running) {
+        charge(thread);
+        running = nullptr;
+    }
+    thread -> fair_sequence = sequence++;
+    heap.push_back(thread);
+    sift_up(heap.size() - 1);
+    update_min_vruntime();
+}
+
+void FairPolicy::dequeue(Thread* thread) {
+    if (thread == running) {
+        running = nullptr;
+    }
+    size_t index = thread -> heap_index;
+    if (index >= heap.size() || heap[index] != thread) {
+        return;
+    }
+    Thread* last = heap.back();
+    heap.pop_back();
+    if (last != thread) {
+        place(index, last);
+        sift_up(index);
+        sift_down(last -> heap_index);
+    }
+}
+
+Thread* FairPolicy::pick_next() {
+    Thread* next = heap.front();
+    dequeue(next);
+    return next;
+}
+
+void FairPolicy::tick(Thread* current) {
+    charge(current);
+    update_min_vruntime();
+}
+
+void FairPolicy::on_block(Thread* current) {
+    charge(current);
+    running = nullptr;
+}
+
+void FairPolicy::on_wake(Thread* thread) {
+    uint64_t floor = min_vruntime > wake_credit ? min_vruntime - wake_credit : 0;
+    if (thread -> vruntime < floor) {
+        thread -> vruntime = floor;
+    }
+}
+
+void FairPolicy::on_run(Thread* thread) {
+    running = thread;
+    charged_at = now_nsecs();
+    update_min_vruntime();
+}
+
+void FairPolicy::reserve(size_t capacity) {
+    heap.reserve(capacity);
+}
+
+void FairPolicy::set_wake_credit(uint64_t nsecs) {
+    wake_credit = nsecs;
+}
+
+void FairPolicy::charge(Thread* current) {
+    if (current != running) {
+        return;
+    }
+    uint64_t now = now_nsecs();
+    current -> vruntime += (now - charged_at) * DEFAULT_WEIGHT / current -> weight;
+    charged_at = now;
+}
+
+void FairPolicy::update_min_vruntime() {
+    uint64_t smallest;
+    if (running != nullptr && !heap.empty()) {
+        smallest = std::min(running -> vruntime, heap.front() -> vruntime);
+    } else if (running != nullptr) {
+        smallest = running -> vruntime;
+    } else if (!heap.empty()) {
+        smallest = heap.front() -> vruntime;
+    } else {
+        return;
+    }
+    min_vruntime = std::max(min_vruntime, smallest);
+}
+
+bool FairPolicy::before(const Thread* a, const Thread* b) const {
+    if (a -> vruntime != b -> vruntime) {
+        return a -> vruntime < b -> vruntime;
+    }
+    return a -> fair_sequence < b -> fair_sequence;
+}
+
+void FairPolicy::place(size_t index, Thread* thread) {
+    heap[index] = thread;
+    thread -> heap_index = index;
+}
+
+void FairPolicy::sift_up(size_t index) {
+    Thread* thread = heap[index];
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!before(thread, heap[parent])) {
+            break;
+        }
+        place(index, heap[parent]);
+        index = parent;
+    }
+    place(index, thread);
+}
+
+void FairPolicy::sift_down(size_t index) {
+    Thread* thread = heap[index];
+    while (true) {
+        size_t child = 2 * index + 1;
+        if (child >= heap.size()) {
+            break;
+        }
+        if (child + 1 < heap.size() && before(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!before(heap[child], thread)) {
+            break;
+        }
+        place(index, heap[child]);
+        index = child;
+    }
+    place(index, thread);
+}
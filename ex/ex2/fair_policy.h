@@ -0,0 +1,62 @@
+#ifndef FAIR_POLICY_H
+#define FAIR_POLICY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "scheduler_policy.h"
+
+/*
+ * A fair policy in the style of Linux's CFS: every thread has a virtual runtime, the CPU time it ran for scaled by
+ * DEFAULT_WEIGHT / Thread::weight, and the READY thread with the smallest one runs next, for a quantum. Over time every
+ * thread gets a share of the CPU proportional to its weight.
+ *
+ * The READY threads are kept in a binary min-heap on (vruntime, enqueue order), whose positions are stored in
+ * Thread::heap_index, so enqueue, dequeue and pick_next are O(log n). Run time is measured on CLOCK_MONOTONIC, which
+ * is read without a system call. A thread that wakes up is placed at most the wake credit behind the smallest virtual
+ * runtime, so sleeping does not bank CPU time for later. Once reserve has made room for every thread, no call
+ * allocates, so the policy can be used from the timer signal handler.
+ */
+class FairPolicy : public SchedulerPolicy {
+public:
+    FairPolicy();
+
+    bool empty() const override;
+    void enqueue(Thread* thread) override;
+    void dequeue(Thread* thread) override;
+    Thread* pick_next() override;
+    void tick(Thread* current) override;
+    void on_block(Thread* current) override;
+    void on_wake(Thread* thread) override;
+    void on_run(Thread* thread) override;
+
+    /* Makes room for capacity threads. */
+    void reserve(size_t capacity);
+
+    /* Sets the wake credit, in nanoseconds of virtual runtime. */
+    void set_wake_credit(uint64_t nsecs);
+
+private:
+    /* Adds the CPU time current ran for since it was last charged to its virtual runtime. */
+    void charge(Thread* current);
+    void update_min_vruntime();
+
+    bool before(const Thread* a, const Thread* b) const;
+    void place(size_t index, Thread* thread);
+    void sift_up(size_t index);
+    void sift_down(size_t index);
+
+    std::vector<Thread*> heap;
+
+    // the running thread and when it was last charged (nullptr once it is queued or blocked)
+    Thread* running;
+    uint64_t charged_at;
+
+    // never decreases, so a thread that was away for long cannot fall far behind the others
+    uint64_t min_vruntime;
+    uint64_t wake_credit;
+    uint64_t sequence;
+};
+
+#endif // FAIR_POLICY_H
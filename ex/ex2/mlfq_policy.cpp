@@ -0,0 +1,83 @@
+#include "mlfq_policy.h"
+#include "thread.h"
+
+MlfqPolicy::MlfqPolicy() : epoch(0) {}
+
+bool MlfqPolicy::empty() const {
+    for (const RunQueue& level : levels) {
+        if (!level.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int MlfqPolicy::level_of(Thread* thread) {
+    if (thread -> level_epoch != epoch) {
+        thread -> level = 0;
+        thread -> level_epoch = epoch;
+    }
+    return thread -> level;
+}
+
+void MlfqPolicy::enqueue(Thread* thread) {
+    levels[level_of(thread)].push_back(thread);
+}
+
+void MlfqPolicy::dequeue(Thread* thread) {
+    if (thread -> run_queue >= levels && thread -> run_queue < levels + PRIORITY_LEVELS) {
+        thread -> run_queue -> remove(thread);
+    }
+}
+
+Thread* MlfqPolicy::pick_next() {
+    for (RunQueue& level : levels) {
+        if (!level.empty()) {
+            return level.pop_front();
+        }
+    }
+    return nullptr;
+}
+
+void MlfqPolicy::tick(Thread* current) {
+    // A thread that used up its time slice moves down a level
+    if (level_of(current) < PRIORITY_LEVELS - 1) {
+        current -> level++;
+    }
+}
+
+void MlfqPolicy::on_block(Thread* current) {
+    // A thread that gives up the CPU early moves up a level
+    if (level_of(current) > 0) {
+        current -> level--;
+    }
+}
+
+void MlfqPolicy::on_wake(Thread* thread) {}
+
+void MlfqPolicy::on_quantum(uint64_t total_quantums) {
+    if (total_quantums % MLFQ_RESET_QUANTA != 0) {
+        return;
+    }
+    epoch++;
+    for (int i = 1; i < PRIORITY_LEVELS; i++) {
+        while (!levels[i].empty()) {
+            Thread* thread = levels[i].pop_front();
+            level_of(thread);
+            levels[0].push_back(thread);
+        }
+    }
+}
+
+bool MlfqPolicy::fixed_quantum() const {
+    return false;
+}
+
+int MlfqPolicy::slice_shift(Thread* thread) {
+    return level_of(thread);
+}
+
+void MlfqPolicy::set_level(Thread* thread, int level) {
+    thread -> level = level;
+    thread -> level_epoch = epoch;
+}
@@ -0,0 +1,45 @@
+#ifndef MLFQ_POLICY_H
+#define MLFQ_POLICY_H
+
+#include <cstdint>
+
+#include "run_queue.h"
+#include "scheduler_policy.h"
+#include "uthreads.h"
+
+/*
+ * The multilevel feedback queue policy: one RunQueue per priority level, 0 being the highest, and the first thread of
+ * the highest non-empty level runs next, for 2^level quanta.
+ *
+ * A thread is queued at its current level (Thread::level), which moves down when the thread uses up its time slice and
+ * up when it blocks early. Once every MLFQ_RESET_QUANTA quanta every thread is moved to the highest level: the queued
+ * ones right away, the others (running, blocked or sleeping) when their level is next looked at, so a reset costs
+ * O(READY threads) however many threads there are.
+ */
+class MlfqPolicy : public SchedulerPolicy {
+public:
+    MlfqPolicy();
+
+    bool empty() const override;
+    void enqueue(Thread* thread) override;
+    void dequeue(Thread* thread) override;
+    Thread* pick_next() override;
+    void tick(Thread* current) override;
+    void on_block(Thread* current) override;
+    void on_wake(Thread* thread) override;
+    void on_quantum(uint64_t total_quantums) override;
+    bool fixed_quantum() const override;
+    int slice_shift(Thread* thread) override;
+
+    /* Puts thread, which must not be queued, on the given level. */
+    void set_level(Thread* thread, int level);
+
+private:
+    /* The current level of thread, after any reset it has not seen yet. */
+    int level_of(Thread* thread);
+
+    RunQueue levels[PRIORITY_LEVELS];
+    uint64_t epoch;
+};
+
+#endif // MLFQ_POLICY_H
@@ -0,0 +1,12 @@
+#ifndef PREEMPT_H
+#define PREEMPT_H
+
+/*
+ * Deferred preemption. Between preempt_disable and preempt_enable the running thread keeps the CPU: a SIGVTALRM
+ * that arrives meanwhile only marks the tick as pending, and preempt_enable runs it, once however many came in.
+ * Every public call of the library changes the scheduler state between them. The calls do not nest.
+ */
+void preempt_disable();
+void preempt_enable();
+
+#endif // PREEMPT_H
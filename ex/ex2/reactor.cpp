@@ -0,0 +1,99 @@
+#include "reactor.h"
+
+#include <cerrno>
+#include <unistd.h>
+
+#include "wait_queue.h"
+
+Reactor::Reactor() : epoll_fd(-1), armed_count(0) {}
+
+Reactor::~Reactor() {
+    for (FdWaiters* waiters : fds) {
+        delete waiters;
+    }
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+    }
+}
+
+bool Reactor::init() {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    return epoll_fd >= 0;
+}
+
+uthread_wait_queue* Reactor::waiters(int fd, uint32_t direction) {
+    if ((size_t) fd >= fds.size()) {
+        fds.resize(fd + 1, nullptr);
+    }
+    if (fds[fd] == nullptr) {
+        fds[fd] = new FdWaiters;
+        wait_queue_init(&fds[fd] -> readers);
+        wait_queue_init(&fds[fd] -> writers);
+        fds[fd] -> registered = false;
+        fds[fd] -> armed = false;
+    }
+    return direction == EPOLLIN ? &fds[fd] -> readers : &fds[fd] -> writers;
+}
+
+bool Reactor::arm(int fd) {
+    FdWaiters* waiters = fds[fd];
+    struct epoll_event event = {};
+    event.events = EPOLLONESHOT;
+    if (!wait_queue_empty(&waiters -> readers)) {
+        event.events |= EPOLLIN;
+    }
+    if (!wait_queue_empty(&waiters -> writers)) {
+        event.events |= EPOLLOUT;
+    }
+    event.data.fd = fd;
+    // An fd that was closed and reopened since it was registered is no longer known to epoll
+    int result = -1;
+    if (waiters -> registered) {
+        result = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+    }
+    if (result < 0 && (!waiters -> registered || errno == ENOENT)) {
+        result = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+    if (result < 0) {
+        return false;
+    }
+    waiters -> registered = true;
+    if (!waiters -> armed) {
+        waiters -> armed = true;
+        armed_count++;
+    }
+    return true;
+}
+
+bool Reactor::armed() const {
+    return armed_count > 0;
+}
+
+int Reactor::wait(struct epoll_event* events, int max_events, int timeout_msecs) {
+    return epoll_wait(epoll_fd, events, max_events, timeout_msecs);
+}
+
+void Reactor::dispatch(const struct epoll_event* events, int count, reactor_wake_fn wake) {
+    for (int i = 0; i < count; i++) {
+        FdWaiters* waiters = fds[events[i].data.fd];
+        if (waiters -> armed) {
+            waiters -> armed = false;
+            armed_count--;
+        }
+        // An error or a hang-up wakes everybody, the calls they retry report it
+        uint32_t ready = events[i].events;
+        if (ready & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+            while (!wait_queue_empty(&waiters -> readers)) {
+                wake(wait_queue_pop(&waiters -> readers));
+            }
+        }
+        if (ready & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+            while (!wait_queue_empty(&waiters -> writers)) {
+                wake(wait_queue_pop(&waiters -> writers));
+            }
+        }
+        if (!wait_queue_empty(&waiters -> readers) || !wait_queue_empty(&waiters -> writers)) {
+            arm(events[i].data.fd);
+        }
+    }
+}
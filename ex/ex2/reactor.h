@@ -0,0 +1,61 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <cstdint>
+#include <sys/epoll.h>
+#include <vector>
+
+#include "uthreads.h"
+
+struct Waiter;
+
+typedef void (*reactor_wake_fn)(Waiter* waiter);
+
+/*
+ * The threads (and coroutines) parked until a file descriptor is ready, and the epoll instance that tells when.
+ *
+ * Every fd has a queue of waiters to read and one of waiters to write. An fd is registered with
+ * EPOLLONESHOT for the directions its waiters need, so an event is reported to one poller only and the fd is re-armed
+ * only while something still waits on it. All calls but wait are made with the scheduler lock held.
+ */
+class Reactor {
+public:
+    Reactor();
+    ~Reactor();
+
+    /* Creates the epoll instance. Returns false, with errno set, if it fails. */
+    bool init();
+
+    /* The queue of the waiters for fd to be readable (EPOLLIN) or writable (EPOLLOUT). Throws bad_alloc when
+     * the table of fds cannot grow. */
+    uthread_wait_queue* waiters(int fd, uint32_t direction);
+
+    /* Registers fd for the directions its waiters need. Returns false, with errno set, if epoll refuses it. */
+    bool arm(int fd);
+
+    /* Whether any fd is registered. */
+    bool armed() const;
+
+    /* Waits up to timeout_msecs (0 to only look) for events on the registered fds, and returns how many were stored in
+     * events (at most max_events), or -1. Called without the scheduler lock. */
+    int wait(struct epoll_event* events, int max_events, int timeout_msecs);
+
+    /* Takes the waiters of every ready fd in events off their queues and passes them to wake, and re-arms the fds that
+     * still have waiters. */
+    void dispatch(const struct epoll_event* events, int count, reactor_wake_fn wake);
+
+private:
+    struct FdWaiters {
+        uthread_wait_queue readers;
+        uthread_wait_queue writers;
+        bool registered;
+        bool armed;
+    };
+
+    // indexed by fd; every entry is allocated once, so the queues never move
+    std::vector<FdWaiters*> fds;
+    int epoll_fd;
+    int armed_count;
+};
+
+#endif // REACTOR_H
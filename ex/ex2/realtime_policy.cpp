@@ -0,0 +1,242 @@
+#include "realtime_policy.h"
+
+#include "thread.h"
+#include "uthreads.h"
+
+#define MILLIONTHS 1000000ULL
+
+RealtimePolicy::RealtimePolicy(SchedulerPolicy* regular)
+    : regular_policy(regular), members(0), utilization(0), now(0), sequence(0) {}
+
+static bool is_realtime(const Thread* thread) {
+    return thread -> rt_period != 0;
+}
+
+bool RealtimePolicy::empty() const {
+    return ready.empty() && throttled.empty() && regular_policy -> empty();
+}
+
+void RealtimePolicy::enqueue(Thread* thread) {
+    if (!is_realtime(thread)) {
+        regular_policy -> enqueue(thread);
+        return;
+    }
+    renew(thread);
+    thread -> rt_throttled = thread -> rt_budget_left == 0;
+    push(thread);
+}
+
+void RealtimePolicy::dequeue(Thread* thread) {
+    if (!is_realtime(thread)) {
+        regular_policy -> dequeue(thread);
+        return;
+    }
+    remove(thread);
+}
+
+Thread* RealtimePolicy::pick_next() {
+    if (!ready.empty()) {
+        Thread* next = ready.front();
+        remove(next);
+        return next;
+    }
+    if (!regular_policy -> empty()) {
+        return regular_policy -> pick_next();
+    }
+    Thread* next = throttled.front();
+    remove(next);
+    return next;
+}
+
+void RealtimePolicy::tick(Thread* current) {
+    if (!is_realtime(current)) {
+        regular_policy -> tick(current);
+    }
+}
+
+void RealtimePolicy::on_block(Thread* current) {
+    if (!is_realtime(current)) {
+        regular_policy -> on_block(current);
+    }
+}
+
+void RealtimePolicy::on_wake(Thread* thread) {
+    if (!is_realtime(thread)) {
+        regular_policy -> on_wake(thread);
+        return;
+    }
+    renew(thread);
+}
+
+void RealtimePolicy::on_run(Thread* thread) {
+    if (!is_realtime(thread)) {
+        regular_policy -> on_run(thread);
+        return;
+    }
+    renew(thread);
+    if (thread -> rt_budget_left > 0) {
+        thread -> rt_budget_left--;
+    } else {
+        // Runs only because nothing else is READY
+        thread -> rt_throttled = true;
+    }
+}
+
+void RealtimePolicy::on_quantum(uint64_t total_quantums) {
+    now = total_quantums;
+    while (!throttled.empty() && throttled.front() -> rt_period_start + throttled.front() -> rt_period <= now) {
+        Thread* thread = throttled.front();
+        remove(thread);
+        renew(thread);
+        push(thread);
+    }
+    regular_policy -> on_quantum(total_quantums);
+}
+
+bool RealtimePolicy::fixed_quantum() const {
+    return regular_policy -> fixed_quantum();
+}
+
+int RealtimePolicy::slice_shift(Thread* thread) {
+    // A real-time thread is charged quantum by quantum
+    return is_realtime(thread) ? 0 : regular_policy -> slice_shift(thread);
+}
+
+SchedulerPolicy* RealtimePolicy::regular() const {
+    return regular_policy;
+}
+
+void RealtimePolicy::set_regular(SchedulerPolicy* policy) {
+    regular_policy = policy;
+}
+
+bool RealtimePolicy::admit(Thread* thread, int period, int budget, int deadline, uint64_t total_quantums) {
+    uint64_t old = is_realtime(thread) ? density(thread -> rt_budget, thread -> rt_relative_deadline) : 0;
+    uint64_t total = utilization - old + density(budget, deadline);
+    if (total > RT_MAX_UTILIZATION * MILLIONTHS / 100) {
+        return false;
+    }
+    if (!is_realtime(thread)) {
+        ready.reserve(members + 1);
+        throttled.reserve(members + 1);
+        members++;
+    }
+    utilization = total;
+    now = total_quantums;
+    thread -> rt_period = period;
+    thread -> rt_budget = budget;
+    thread -> rt_relative_deadline = deadline;
+    thread -> rt_period_start = now;
+    thread -> rt_deadline = now + deadline;
+    thread -> rt_budget_left = budget;
+    thread -> rt_throttled = false;
+    return true;
+}
+
+void RealtimePolicy::leave(Thread* thread) {
+    if (!is_realtime(thread)) {
+        return;
+    }
+    utilization -= density(thread -> rt_budget, thread -> rt_relative_deadline);
+    members--;
+    thread -> rt_period = 0;
+    thread -> rt_throttled = false;
+}
+
+int RealtimePolicy::size() const {
+    return members;
+}
+
+bool RealtimePolicy::preempts(const Thread* current, const Thread* thread) const {
+    if (current == nullptr || !is_realtime(thread) || thread -> rt_throttled) {
+        return false;
+    }
+    return !is_realtime(current) || current -> rt_throttled || thread -> rt_deadline < current -> rt_deadline;
+}
+
+void RealtimePolicy::renew(Thread* thread) {
+    if (now < thread -> rt_period_start + thread -> rt_period) {
+        return;
+    }
+    thread -> rt_period_start = now;
+    thread -> rt_deadline = now + thread -> rt_relative_deadline;
+    thread -> rt_budget_left = thread -> rt_budget;
+    thread -> rt_throttled = false;
+}
+
+uint64_t RealtimePolicy::density(int budget, int deadline) {
+    return (budget * MILLIONTHS + deadline - 1) / deadline;
+}
+
+std::vector<Thread*>& RealtimePolicy::heap_of(const Thread* thread) {
+    return thread -> rt_throttled ? throttled : ready;
+}
+
+bool RealtimePolicy::before(const Thread* a, const Thread* b) const {
+    // Both are in the same heap
+    uint64_t a_key = a -> rt_throttled ? a -> rt_period_start + a -> rt_period : a -> rt_deadline;
+    uint64_t b_key = b -> rt_throttled ? b -> rt_period_start + b -> rt_period : b -> rt_deadline;
+    if (a_key != b_key) {
+        return a_key < b_key;
+    }
+    return a -> rt_sequence < b -> rt_sequence;
+}
+
+void RealtimePolicy::push(Thread* thread) {
+    std::vector<Thread*>& heap = heap_of(thread);
+    thread -> rt_sequence = sequence++;
+    heap.push_back(thread);
+    sift_up(heap, heap.size() - 1);
+}
+
+void RealtimePolicy::remove(Thread* thread) {
+    std::vector<Thread*>& heap = heap_of(thread);
+    size_t index = thread -> rt_index;
+    if (index >= heap.size() || heap[index] != thread) {
+        return;
+    }
+    Thread* last = heap.back();
+    heap.pop_back();
+    if (last != thread) {
+        place(heap, index, last);
+        sift_up(heap, index);
+        sift_down(heap, last -> rt_index);
+    }
+}
+
+void RealtimePolicy::place(std::vector<Thread*>& heap, size_t index, Thread* thread) {
+    heap[index] = thread;
+    thread -> rt_index = index;
+}
+
+void RealtimePolicy::sift_up(std::vector<Thread*>& heap, size_t index) {
+    Thread* thread = heap[index];
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!before(thread, heap[parent])) {
+            break;
+        }
+        place(heap, index, heap[parent]);
+        index = parent;
+    }
+    place(heap, index, thread);
+}
+
+void RealtimePolicy::sift_down(std::vector<Thread*>& heap, size_t index) {
+    Thread* thread = heap[index];
+    while (true) {
+        size_t child = 2 * index + 1;
+        if (child >= heap.size()) {
+            break;
+        }
+        if (child + 1 < heap.size() && before(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!before(heap[child], thread)) {
+            break;
+        }
+        place(heap, index, heap[child]);
+        index = child;
+    }
+    place(heap, index, thread);
+}
@@ -0,0 +1,93 @@
+#ifndef REALTIME_POLICY_H
+#define REALTIME_POLICY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "scheduler_policy.h"
+
+/*
+ * The real-time class, in front of the policy that orders the regular threads (round-robin, MLFQ or fair).
+ *
+ * A real-time thread has a period, a budget and a relative deadline, in quanta. Every period it may run for budget
+ * quanta, and while it has budget left it takes precedence over every regular thread: the READY real-time thread with
+ * the earliest absolute deadline runs next (earliest deadline first). Every quantum a real-time thread starts is
+ * charged to its budget, and one that used it up is throttled: it runs only when no other thread is READY, until its
+ * next period starts and renews its budget. A period starts when the thread is made READY or runs at least period
+ * quanta after the last one started, so a thread that waits for long starts afresh when it wakes up.
+ *
+ * A thread is admitted only while the densities budget / deadline of all real-time threads add up to at most
+ * RT_MAX_UTILIZATION percent, so EDF can give every admitted thread its budget before its deadline, and the rest of the
+ * CPU is left to the regular threads.
+ *
+ * The READY real-time threads are kept in a binary min-heap on (deadline, enqueue order), and the throttled ones in
+ * another on the quantum their next period starts at, with positions in Thread::rt_index, so every operation is
+ * O(log n). The heaps have room for every real-time thread, so no call allocates. The regular threads are passed on to
+ * the regular policy, which the scheduler calls directly while there is no real-time thread.
+ */
+class RealtimePolicy : public SchedulerPolicy {
+public:
+    explicit RealtimePolicy(SchedulerPolicy* regular);
+
+    bool empty() const override;
+    void enqueue(Thread* thread) override;
+    void dequeue(Thread* thread) override;
+    Thread* pick_next() override;
+    void tick(Thread* current) override;
+    void on_block(Thread* current) override;
+    void on_wake(Thread* thread) override;
+    void on_run(Thread* thread) override;
+    void on_quantum(uint64_t total_quantums) override;
+    bool fixed_quantum() const override;
+    int slice_shift(Thread* thread) override;
+
+    /* The policy of the regular threads. */
+    SchedulerPolicy* regular() const;
+
+    /* Makes policy order the regular threads. It takes over none of the threads queued in the old one. */
+    void set_regular(SchedulerPolicy* policy);
+
+    /* Makes thread, which must not be queued, a real-time thread with the given parameters, starting its first period
+     * at the current quantum, the total_quantums-th. Returns false, leaving it as it was, if admitting it would take
+     * the real-time threads over RT_MAX_UTILIZATION. Throws std::bad_alloc. */
+    bool admit(Thread* thread, int period, int budget, int deadline, uint64_t total_quantums);
+
+    /* Makes thread, which must not be queued, a regular thread again. */
+    void leave(Thread* thread);
+
+    /* The number of real-time threads. */
+    int size() const;
+
+    /* Whether thread, just made READY, should run before current, the running thread (nullptr if there is none). */
+    bool preempts(const Thread* current, const Thread* thread) const;
+
+private:
+    /* Starts a new period of thread if the last one is over. */
+    void renew(Thread* thread);
+
+    /* The density of a thread with the given parameters, in millionths of the CPU. */
+    static uint64_t density(int budget, int deadline);
+
+    std::vector<Thread*>& heap_of(const Thread* thread);
+    bool before(const Thread* a, const Thread* b) const;
+    void push(Thread* thread);
+    void remove(Thread* thread);
+    void place(std::vector<Thread*>& heap, size_t index, Thread* thread);
+    void sift_up(std::vector<Thread*>& heap, size_t index);
+    void sift_down(std::vector<Thread*>& heap, size_t index);
+
+    SchedulerPolicy* regular_policy;
+
+    // the READY real-time threads with budget left, ordered by deadline, and the throttled ones, ordered by the start
+    // of their next period
+    std::vector<Thread*> ready;
+    std::vector<Thread*> throttled;
+
+    int members;
+    uint64_t utilization;    // the densities of the real-time threads, in millionths of the CPU
+    uint64_t now;            // the current quantum (while the policy is called at all)
+    uint64_t sequence;
+};
+
+#endif // REALTIME_POLICY_H
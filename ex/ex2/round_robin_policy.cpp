@@ -0,0 +1,23 @@
+#include "round_robin_policy.h"
+
+bool RoundRobinPolicy::empty() const {
+    return queue.empty();
+}
+
+void RoundRobinPolicy::enqueue(Thread* thread) {
+    queue.push_back(thread);
+}
+
+void RoundRobinPolicy::dequeue(Thread* thread) {
+    queue.remove(thread);
+}
+
+Thread* RoundRobinPolicy::pick_next() {
+    return queue.pop_front();
+}
+
+void RoundRobinPolicy::tick(Thread* current) {}
+
+void RoundRobinPolicy::on_block(Thread* current) {}
+
+void RoundRobinPolicy::on_wake(Thread* thread) {}
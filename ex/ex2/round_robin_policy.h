@@ -0,0 +1,24 @@
+#ifndef ROUND_ROBIN_POLICY_H
+#define ROUND_ROBIN_POLICY_H
+
+#include "run_queue.h"
+#include "scheduler_policy.h"
+
+/*
+ * The default policy: a single FIFO, every thread running for one quantum at a time.
+ */
+class RoundRobinPolicy : public SchedulerPolicy {
+public:
+    bool empty() const override;
+    void enqueue(Thread* thread) override;
+    void dequeue(Thread* thread) override;
+    Thread* pick_next() override;
+    void tick(Thread* current) override;
+    void on_block(Thread* current) override;
+    void on_wake(Thread* thread) override;
+
+private:
+    RunQueue queue;
+};
+
+#endif // ROUND_ROBIN_POLICY_H
@@ -0,0 +1,51 @@
+#include "run_queue.h"
+#include "thread.h"
+
+RunQueue::RunQueue() : head(nullptr), tail(nullptr), count(0) {}
+
+bool RunQueue::empty() const {
+    return head == nullptr;
+}
+
+size_t RunQueue::size() const {
+    return count;
+}
+
+void RunQueue::push_back(Thread* thread) {
+    thread -> run_next = nullptr;
+    thread -> run_prev = tail;
+    if (tail != nullptr) {
+        tail -> run_next = thread;
+    } else {
+        head = thread;
+    }
+    tail = thread;
+    thread -> run_queue = this;
+    count++;
+}
+
+Thread* RunQueue::pop_front() {
+    Thread* thread = head;
+    remove(thread);
+    return thread;
+}
+
+void RunQueue::remove(Thread* thread) {
+    if (thread -> run_queue != this) {
+        return;
+    }
+    if (thread -> run_prev != nullptr) {
+        thread -> run_prev -> run_next = thread -> run_next;
+    } else {
+        head = thread -> run_next;
+    }
+    if (thread -> run_next != nullptr) {
+        thread -> run_next -> run_prev = thread -> run_prev;
+    } else {
+        tail = thread -> run_prev;
+    }
+    thread -> run_next = nullptr;
+    thread -> run_prev = nullptr;
+    thread -> run_queue = nullptr;
+    count--;
+}
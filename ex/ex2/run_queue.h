@@ -0,0 +1,34 @@
+#ifndef RUN_QUEUE_H
+#define RUN_QUEUE_H
+
+#include <cstddef>
+
+class Thread;
+
+/*
+ * A FIFO of READY threads, linked through the run_next/run_prev pointers embedded in Thread, so enqueue, dequeue
+ * and removal of any thread are O(1) and never allocate.
+ */
+class RunQueue {
+public:
+    RunQueue();
+
+    bool empty() const;
+    size_t size() const;
+
+    /* Appends thread, which must not be in any run queue. */
+    void push_back(Thread* thread);
+
+    /* Removes and returns the first thread. The queue must not be empty. */
+    Thread* pop_front();
+
+    /* Removes thread if it is in this queue, otherwise does nothing. */
+    void remove(Thread* thread);
+
+private:
+    Thread* head;
+    Thread* tail;
+    size_t count;
+};
+
+#endif // RUN_QUEUE_H
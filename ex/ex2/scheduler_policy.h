@@ -0,0 +1,55 @@
+#ifndef SCHEDULER_POLICY_H
+#define SCHEDULER_POLICY_H
+
+#include <cstdint>
+
+class Thread;
+
+/*
+ * How the READY threads of a single carrier are ordered. The scheduler in uthreads.cpp owns the states, the timer and
+ * the switches, and tells the policy what happens to the threads through the calls below. All of them are made with
+ * preemption disabled, so a policy needs no locking, and none of them may allocate (a policy may grow its own arrays
+ * while threads are spawned).
+ */
+class SchedulerPolicy {
+public:
+    virtual ~SchedulerPolicy() = default;
+
+    /* Whether there is no READY thread. */
+    virtual bool empty() const = 0;
+
+    /* Adds a READY thread, which may be the one that was just running. */
+    virtual void enqueue(Thread* thread) = 0;
+
+    /* Removes thread if it is queued, otherwise does nothing. */
+    virtual void dequeue(Thread* thread) = 0;
+
+    /* Removes and returns the thread to run next. There must be one. */
+    virtual Thread* pick_next() = 0;
+
+    /* The running thread used up its time slice, and is about to be enqueued again or to keep running. */
+    virtual void tick(Thread* current) = 0;
+
+    /* The running thread blocks or sleeps itself, before its time slice is over. */
+    virtual void on_block(Thread* current) = 0;
+
+    /* A thread that was spawned, resumed or woken up is about to be enqueued. */
+    virtual void on_wake(Thread* thread) = 0;
+
+    /* thread starts running, after a switch to it or for another time slice. */
+    virtual void on_run(Thread* thread) {}
+
+    /* A new quantum started, the total_quantums-th. */
+    virtual void on_quantum(uint64_t total_quantums) {}
+
+    /* Whether every thread runs for one quantum of the periodic timer. If not, every switch starts a new timer
+     * interval of 2^slice_shift(next) quanta. */
+    virtual bool fixed_quantum() const {
+        return true;
+    }
+    virtual int slice_shift(Thread* thread) {
+        return 0;
+    }
+};
+
+#endif // SCHEDULER_POLICY_H
@@ -0,0 +1,167 @@
+#include "stack_pool.h"
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <stdexcept>
+#include <sys/auxv.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef AT_MINSIGSTKSZ
+#define AT_MINSIGSTKSZ 51
+#endif
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+#define DEFAULT_MAX_MAP_COUNT 65530
+
+/*
+ * The kernel's limit on the number of mappings of a process.
+ */
+static size_t max_map_count() {
+    size_t count = DEFAULT_MAX_MAP_COUNT;
+    FILE* file = fopen("/proc/sys/vm/max_map_count", "r");
+    if (file != nullptr) {
+        if (fscanf(file, "%zu", &count) != 1) {
+            count = DEFAULT_MAX_MAP_COUNT;
+        }
+        fclose(file);
+    }
+    return count;
+}
+
+static char* map_anonymous(size_t size) {
+    void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("mmap of a stack region failed");
+    }
+    return (char*) address;
+}
+
+/*
+ * Backs size bytes at address with physical memory.
+ */
+static void commit_memory(char* address, size_t size, size_t page_size) {
+    if (madvise(address, size, MADV_POPULATE_WRITE) != 0) {
+        // Kernels before 5.14 do not know MADV_POPULATE_WRITE
+        for (size_t offset = 0; offset < size; offset += page_size) {
+            ((volatile char*) address)[offset] = 0;
+        }
+    }
+}
+
+StackPool::StackPool() : guarded_count(0) {
+    page_size = sysconf(_SC_PAGESIZE);
+    size_t signal_frame = getauxval(AT_MINSIGSTKSZ);
+    if (signal_frame < (size_t) MINSIGSTKSZ) {
+        signal_frame = MINSIGSTKSZ;
+    }
+    signal_reserve = signal_frame + STACK_SIGNAL_MARGIN;
+    // Each guarded stack takes about two mappings, the guard and the stack itself
+    guard_budget = max_map_count() / 8;
+}
+
+void StackPool::carve(Stack& stack) {
+    size_t pages = stack.size / page_size;
+    size_t guard = guarded_count < guard_budget ? page_size : 0;
+    size_t slot = guard + stack.size;
+
+    if (pages > STACK_POOL_MAX_PAGES) {
+        char* address = map_anonymous(slot);
+        if (guard != 0 && mprotect(address, guard, PROT_NONE) != 0) {
+            munmap(address, slot);
+            throw std::runtime_error("mprotect of a stack guard page failed");
+        }
+        guarded_count += guard != 0;
+        stack.base = address + guard;
+        stack.guard = guard;
+        return;
+    }
+
+    SizeClass& size_class = classes[pages];
+    size_class.carved++;
+    if (size_class.free.capacity() < size_class.carved) {
+        size_class.free.reserve(2 * size_class.carved);
+    }
+    Region& region = size_class.region;
+    if (region.next == nullptr || (size_t) (region.end - region.next) < slot) {
+        // The rest of the old region is too small for this size and is left unused
+        size_t region_size = slot > STACK_REGION_SIZE ? slot : STACK_REGION_SIZE;
+        region.next = map_anonymous(region_size);
+        region.end = region.next + region_size;
+    }
+    char* address = region.next;
+    if (guard != 0 && mprotect(address, guard, PROT_NONE) != 0) {
+        throw std::runtime_error("mprotect of a stack guard page failed");
+    }
+    region.next += slot;
+    guarded_count += guard != 0;
+    stack.base = address + guard;
+    stack.guard = guard;
+}
+
+Stack StackPool::acquire(size_t size, bool commit) {
+    size_t pages = (size + signal_reserve + page_size - 1) / page_size;
+    Stack stack = {nullptr, pages * page_size, 0};
+    if (pages <= STACK_POOL_MAX_PAGES) {
+        if (classes.size() <= pages) {
+            classes.resize(pages + 1, SizeClass{{nullptr, nullptr}, {}, 0, 0, 0, 0});
+        }
+        SizeClass& size_class = classes[pages];
+        if (!size_class.free.empty()) {
+            stack = size_class.free.back();
+            size_class.free.pop_back();
+            size_class.cold = std::min(size_class.cold, size_class.free.size());
+            size_class.min_warm = std::min(size_class.min_warm, size_class.free.size() - size_class.cold);
+        }
+    }
+    if (stack.base == nullptr) {
+        carve(stack);
+    }
+    if (commit) {
+        commit_memory(stack.base, stack.size, page_size);
+    }
+    return stack;
+}
+
+void StackPool::release(const Stack& stack) {
+    size_t pages = stack.size / page_size;
+    if (pages > STACK_POOL_MAX_PAGES) {
+        munmap(stack.base - stack.guard, stack.guard + stack.size);
+        guarded_count -= stack.guard != 0;
+        return;
+    }
+    SizeClass& size_class = classes[pages];
+    size_class.free.push_back(stack);
+    if (++size_class.releases == STACK_POOL_TRIM_PERIOD) {
+        trim(size_class);
+    }
+}
+
+void StackPool::trim(SizeClass& size_class) {
+    // free is a stack, so the oldest min_warm stacks with memory were not acquired since the last trim
+    size_t idle = size_class.min_warm > STACK_POOL_HOT_STACKS ? size_class.min_warm - STACK_POOL_HOT_STACKS : 0;
+    auto first = size_class.free.begin() + size_class.cold;
+    auto last = first + idle;
+    // Sorted, stacks carved one after the other from a region are next to each other and take one call
+    std::sort(first, last, [](const Stack& a, const Stack& b) { return a.base < b.base; });
+    while (first != last) {
+        char* start = first -> base;
+        char* end = first -> base + first -> size;
+        for (first++; first != last && first -> base - first -> guard == end; first++) {
+            end = first -> base + first -> size;
+        }
+        madvise(start, end - start, MADV_DONTNEED);
+    }
+    size_class.cold += idle;
+    size_class.min_warm = size_class.free.size() - size_class.cold;
+    size_class.releases = 0;
+}
+
+size_t StackPool::guarded() const {
+    return guarded_count;
+}
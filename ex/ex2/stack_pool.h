@@ -0,0 +1,83 @@
+#ifndef STACK_POOL_H
+#define STACK_POOL_H
+
+#include <cstddef>
+#include <vector>
+
+#define STACK_REGION_SIZE (2 * 1024 * 1024)   /* stacks are carved from mappings of at least this size */
+#define STACK_POOL_MAX_PAGES 256               /* larger stacks get a mapping of their own and are not recycled */
+#define STACK_POOL_HOT_STACKS 16               /* idle stacks per size that keep their physical memory */
+#define STACK_POOL_TRIM_PERIOD 1024            /* releases of a size between two looks at its idle stacks */
+#define STACK_SIGNAL_MARGIN 2048               /* room for the scheduler's own frames under a signal frame */
+
+/*
+ * A thread stack: size usable bytes starting at base (the stack grows down from base + size), above a guard of
+ * guard bytes (0 if it has none).
+ */
+struct Stack {
+    char* base;
+    size_t size;
+    size_t guard;
+};
+
+/*
+ * Hands out thread stacks carved from large anonymous mappings, with a PROT_NONE guard page below each one, and
+ * recycles them.
+ *
+ * Stacks are grouped by their size in pages. A released stack goes on the free list of its size and is handed out
+ * again before anything new is carved, guard page included. Every STACK_POOL_TRIM_PERIOD releases of a size, the
+ * stacks that stayed idle through the whole period, but for STACK_POOL_HOT_STACKS of them, give their physical pages
+ * back with madvise(MADV_DONTNEED), neighbouring stacks merged into one call. So a burst of threads does not pin its
+ * peak memory forever, while threads that are spawned and end at a steady rate keep reusing stacks that still have
+ * their memory, however many of them there are at a time. Mappings are never unmapped.
+ *
+ * Every guard page splits the mapping, and the number of mappings of a process is limited by vm.max_map_count. Once
+ * the guarded stacks would take a quarter of that limit, new stacks are carved without a guard page, so large
+ * numbers of threads still fit.
+ *
+ * The timer signal is delivered on the running thread's stack, so every stack also gets room for a signal frame,
+ * whose size (AT_MINSIGSTKSZ) depends on the CPU's register state and is well over 4 KiB with AVX-512 or AMX.
+ */
+class StackPool {
+public:
+    StackPool();
+
+    /* A stack with at least size bytes for the thread's own use. Its memory is committed right away if commit is
+     * true, and on first touch otherwise. Throws std::runtime_error if no memory can be mapped. */
+    Stack acquire(size_t size, bool commit = false);
+
+    /* Returns a stack taken from acquire. Never allocates, so it may run on a thread that was preempted anywhere. */
+    void release(const Stack& stack);
+
+    /* The number of stacks that have a guard page. */
+    size_t guarded() const;
+
+private:
+    struct Region {
+        char* next;    // the first address that was not carved yet
+        char* end;
+    };
+
+    struct SizeClass {
+        Region region;
+        std::vector<Stack> free;    // has room for every stack carved, so release never allocates
+        size_t cold;                // the first cold entries of free have no physical memory
+        size_t min_warm;            // the fewest idle stacks with memory since the last trim
+        size_t releases;            // since the last trim
+        size_t carved;
+    };
+
+    /* Maps stack.size bytes for a new stack, filling in its base and guard. */
+    void carve(Stack& stack);
+
+    /* Gives back the memory of the idle stacks of a size that were not needed since the last trim but the hot ones. */
+    void trim(SizeClass& size_class);
+
+    std::vector<SizeClass> classes;    // indexed by the number of usable pages
+    size_t page_size;
+    size_t signal_reserve;
+    size_t guard_budget;
+    size_t guarded_count;
+};
+
+#endif // STACK_POOL_H
@@ -0,0 +1,141 @@
+/*
+ * test10_io.cpp - Threads that wait for I/O. A thread reading an empty pipe is parked while the main thread keeps
+ * running, and gets the data once the main thread writes it. Then an echo server on a loopback socket accepts
+ * connections, with a thread per connection, while client threads connect, send a message and check what comes back.
+ * The main thread waits for the clients on a semaphore.
+ *
+ * Output should be the same as test10_io.txt.
+ */
+
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "uthreads.h"
+
+#define CLIENTS 8
+#define MESSAGE_SIZE 32
+
+static int pipe_fds[2];
+static char pipe_data[MESSAGE_SIZE];
+static volatile int pipe_read = 0;
+
+static int listener;
+static struct sockaddr_in address;
+static uthread_sem clients_done;
+static int echoed = 0;
+
+void pipe_reader()
+{
+    ssize_t size = uthread_read(pipe_fds[0], pipe_data, sizeof(pipe_data) - 1);
+    pipe_read = (int) size;
+    uthread_terminate(uthread_get_tid());
+}
+
+void* echo(void* arg)
+{
+    int fd = (int) (long) arg;
+    char buffer[MESSAGE_SIZE];
+    ssize_t size;
+    while ((size = uthread_read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        uthread_write(fd, buffer, size);
+    }
+    close(fd);
+    return nullptr;
+}
+
+void server()
+{
+    for (int i = 0; i < CLIENTS; i++)
+    {
+        int fd = uthread_accept(listener, nullptr, nullptr);
+        if (fd < 0)
+        {
+            perror("accept");
+            break;
+        }
+        uthread_spawn_ex(echo, (void*) (long) fd, nullptr);
+    }
+    uthread_terminate(uthread_get_tid());
+}
+
+void* client(void* arg)
+{
+    long index = (long) arg;
+    char message[MESSAGE_SIZE];
+    char reply[MESSAGE_SIZE];
+    int length = snprintf(message, sizeof(message), "hello from client %ld", index);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (uthread_connect(fd, (struct sockaddr*) &address, sizeof(address)) == 0 &&
+        uthread_write(fd, message, length) == length)
+    {
+        int received = 0;
+        ssize_t size = 1;
+        while (received < length && size > 0)
+        {
+            size = uthread_read(fd, reply + received, length - received);
+            received += size > 0 ? (int) size : 0;
+        }
+        if (received == length && memcmp(message, reply, length) == 0)
+        {
+            echoed++;
+        }
+    }
+    close(fd);
+    uthread_sem_post(&clients_done);
+    return nullptr;
+}
+
+int main()
+{
+    uthread_init(1000);
+
+    pipe(pipe_fds);
+    int tid = uthread_spawn(pipe_reader);
+    int start = uthread_get_total_quantums();
+    while (uthread_get_total_quantums() < start + 5)
+    {
+    }
+    printf("reader waits while the main thread runs: %s\n", pipe_read == 0 ? "yes" : "no");
+    printf("resume of the waiting reader returns %d\n", uthread_resume(tid));
+    write(pipe_fds[1], "through the pipe", 16);
+    while (pipe_read == 0)
+    {
+        uthread_yield();
+    }
+    printf("reader got %d bytes: %s\n", pipe_read, pipe_data);
+
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t size = sizeof(address);
+    if (bind(listener, (struct sockaddr*) &address, size) < 0 || listen(listener, CLIENTS) < 0 ||
+        getsockname(listener, (struct sockaddr*) &address, &size) < 0)
+    {
+        perror("listen");
+        return 1;
+    }
+
+    uthread_sem_init(&clients_done, 0);
+    uthread_spawn(server);
+    for (long i = 0; i < CLIENTS; i++)
+    {
+        uthread_spawn_ex(client, (void*) i, nullptr);
+    }
+    for (int i = 0; i < CLIENTS; i++)
+    {
+        uthread_sem_wait(&clients_done);
+    }
+    printf("%d of %d clients got their message back\n", echoed, CLIENTS);
+
+    close(listener);
+    uthread_terminate(0);
+    return 0;
+}
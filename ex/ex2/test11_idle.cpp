@@ -0,0 +1,77 @@
+/*
+ * test11_idle.cpp - Every thread sleeps, and the main thread waits for them on a semaphore. Nothing is runnable, so
+ * the process must sleep too: the quanta go by in real time, the sleepers wake up on time and in order, and almost no
+ * CPU is used meanwhile.
+ *
+ * Output should be the same as test11_idle.txt.
+ */
+
+#include <cstdio>
+#include <ctime>
+#include "uthreads.h"
+
+#define QUANTUM_USECS 1000
+#define SLEEPERS 4
+#define SLEEP_QUANTA 200
+
+static uthread_sem done;
+static int woke_after[SLEEPERS + 1];
+static int wake_order[SLEEPERS + 1];
+static int woken = 0;
+
+void sleeper()
+{
+    int tid = uthread_get_tid();
+    int start = uthread_get_total_quantums();
+    uthread_sleep(SLEEP_QUANTA * tid / SLEEPERS);
+    woke_after[tid] = uthread_get_total_quantums() - start;
+    wake_order[tid] = ++woken;
+    uthread_sem_post(&done);
+    uthread_terminate(tid);
+}
+
+static double elapsed_msecs(clockid_t clock, const struct timespec* since)
+{
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (now.tv_sec - since->tv_sec) * 1e3 + (now.tv_nsec - since->tv_nsec) / 1e6;
+}
+
+int main()
+{
+    uthread_init(QUANTUM_USECS);
+    uthread_sem_init(&done, 0);
+
+    struct timespec wall, cpu;
+    clock_gettime(CLOCK_MONOTONIC, &wall);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    for (int i = 1; i <= SLEEPERS; i++)
+    {
+        uthread_spawn(sleeper);
+    }
+    for (int i = 1; i <= SLEEPERS; i++)
+    {
+        uthread_sem_wait(&done);
+    }
+    double wall_msecs = elapsed_msecs(CLOCK_MONOTONIC, &wall);
+    double cpu_msecs = elapsed_msecs(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+
+    // As in test7_mlfq, sleep(n) wakes up n + 2 quanta after the call, less one if a tick the kernel delivers late
+    // while the process is idle is counted before the call. On a loaded machine a sleeper can be woken later still, so
+    // only the earliest wake-up is checked
+    bool on_time = true;
+    bool in_order = true;
+    for (int tid = 1; tid <= SLEEPERS; tid++)
+    {
+        int expected = SLEEP_QUANTA * tid / SLEEPERS + 2;
+        on_time = on_time && woke_after[tid] >= expected - 1;
+        in_order = in_order && wake_order[tid] == tid;
+    }
+    printf("sleepers did not wake up before their quanta: %s\n", on_time ? "yes" : "no");
+    printf("sleepers woke up in order: %s\n", in_order ? "yes" : "no");
+    printf("the quanta went by in real time: %s\n",
+           wall_msecs >= SLEEP_QUANTA * QUANTUM_USECS / 1000 * 0.9 ? "yes" : "no");
+    printf("less than a tenth of that was CPU time: %s\n", cpu_msecs < wall_msecs / 10 ? "yes" : "no");
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * test12_sleep_ns.cpp - With quanta of 100 ms, a thread sleeps until deadlines a fraction of a millisecond apart and
+ * must not wake up before any of them; threads that sleep until deadlines in the reverse of the order they were spawned
+ * in must wake up in deadline order. Then the main thread runs alone, with the ticks stopped, and still sees the quanta
+ * go by as it uses the CPU.
+ *
+ * Output should be the same as test12_sleep_ns.txt.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include "uthreads.h"
+
+#define QUANTUM_USECS 100000
+#define SLEEPS 10
+#define SLEEP_NSECS 300000ULL
+#define ORDERED_SLEEPERS 4
+#define ORDER_START_NSECS 50000000ULL
+
+static volatile int done = 0;
+static bool early = false;
+static uint64_t order_start;
+static int wake_order[ORDERED_SLEEPERS];
+static int started = 0;
+static int woken = 0;
+
+static uint64_t now_nsecs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void sleeper()
+{
+    uint64_t deadline = now_nsecs();
+    for (int i = 0; i < SLEEPS; i++)
+    {
+        deadline += SLEEP_NSECS;
+        uthread_sleep_ns(deadline);
+        uint64_t woke = now_nsecs();
+        early = early || woke < deadline;
+    }
+    done = 1;
+    uthread_terminate(uthread_get_tid());
+}
+
+void ordered_sleeper()
+{
+    // The ones started first sleep longest
+    int index = started++;
+    uthread_sleep_ns(order_start + (ORDERED_SLEEPERS - index) * SLEEP_NSECS);
+    wake_order[index] = woken++;
+    uthread_terminate(uthread_get_tid());
+}
+
+int main()
+{
+    uthread_init(QUANTUM_USECS);
+    printf("main thread sleep_ns returns %d\n", uthread_sleep_ns(0));
+
+    uthread_spawn(sleeper);
+    while (!done)
+    {
+        uthread_yield();
+    }
+    printf("%d sleeps, none woke up early: %s\n", SLEEPS, early ? "no" : "yes");
+
+    // Far enough ahead that every sleeper is asleep before the first deadline, even on a loaded machine
+    order_start = now_nsecs() + ORDER_START_NSECS;
+    for (int i = 1; i <= ORDERED_SLEEPERS; i++)
+    {
+        uthread_spawn(ordered_sleeper);
+    }
+    while (woken < ORDERED_SLEEPERS)
+    {
+        uthread_yield();
+    }
+    bool in_order = true;
+    for (int i = 0; i < ORDERED_SLEEPERS; i++)
+    {
+        in_order = in_order && wake_order[i] == ORDERED_SLEEPERS - 1 - i;
+    }
+    printf("%d sleepers woke up in deadline order: %s\n", ORDERED_SLEEPERS, in_order ? "yes" : "no");
+
+    int start = uthread_get_total_quantums();
+    while (uthread_get_total_quantums() < start + 3)
+    {
+    }
+    printf("quanta counted while the main thread ran alone: %d\n", uthread_get_total_quantums() - start);
+    uthread_terminate(0);
+    return 0;
+}
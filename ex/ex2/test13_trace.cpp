@@ -0,0 +1,116 @@
+/*
+ * test13_trace.cpp - Traces a thread that yields, one that sleeps and one that is blocked and resumed, checks their
+ * statistics and that the exported trace has a track of runs for each of them.
+ *
+ * Output should be the same as test13_trace.txt.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "uthreads.h"
+
+#define ROUNDS 20
+#define TRACE_EVENTS 4096
+#define TRACE_PATH "/tmp/uthreads_test13_trace.json"
+
+static std::atomic<int> finished(0);
+
+void yielder()
+{
+    for (int i = 0; i < ROUNDS; i++)
+    {
+        uthread_yield();
+    }
+    finished++;
+    uthread_block(uthread_get_tid());
+}
+
+void sleeper()
+{
+    for (int i = 0; i < ROUNDS / 4; i++)
+    {
+        uthread_sleep(1);
+    }
+    finished++;
+    uthread_block(uthread_get_tid());
+}
+
+void blocked()
+{
+    uthread_block(uthread_get_tid());
+    finished++;
+    uthread_block(uthread_get_tid());
+}
+
+static void check(int tid, const char* name, int min_runs)
+{
+    uthread_stats stats;
+    if (uthread_get_stats(tid, &stats) != 0)
+    {
+        printf("%s: no stats\n", name);
+        return;
+    }
+    uint64_t histogram = 0;
+    for (int i = 0; i < UTHREAD_LATENCY_BUCKETS; i++)
+    {
+        histogram += stats.latency_histogram[i];
+    }
+    // Every run of a spawned thread follows a wait in the ready queue
+    printf("%s: ran at least %d times: %s, ran and waited for some time: %s, every wait is in the histogram: %s\n",
+           name, min_runs, stats.runs >= (uint64_t) min_runs ? "yes" : "no",
+           stats.run_nsecs > 0 && stats.wait_nsecs > 0 ? "yes" : "no", histogram == stats.runs ? "yes" : "no");
+}
+
+static bool contains(const char* text, const char* format, int tid)
+{
+    char needle[64];
+    snprintf(needle, sizeof(needle), format, tid);
+    return strstr(text, needle) != nullptr;
+}
+
+int main()
+{
+    uthread_init(1000);
+    printf("stop before start returns %d\n", uthread_trace_stop());
+    printf("start returns %d\n", uthread_trace_start(TRACE_EVENTS));
+    printf("second start returns %d\n", uthread_trace_start(TRACE_EVENTS));
+
+    int tids[3];
+    tids[0] = uthread_spawn(yielder);
+    tids[1] = uthread_spawn(sleeper);
+    tids[2] = uthread_spawn(blocked);
+    while (finished < 2)
+    {
+        uthread_yield();
+    }
+    uthread_resume(tids[2]);
+    while (finished < 3)
+    {
+        uthread_yield();
+    }
+
+    printf("export while tracing returns %d\n", uthread_trace_export(TRACE_PATH));
+    printf("stop returns %d\n", uthread_trace_stop());
+    check(tids[0], "yielder", ROUNDS);
+    check(tids[1], "sleeper", ROUNDS / 4);
+    check(tids[2], "blocked", 2);
+
+    printf("export returns %d\n", uthread_trace_export(TRACE_PATH));
+    FILE* file = fopen(TRACE_PATH, "r");
+    static char text[1 << 20];
+    size_t size = fread(text, 1, sizeof(text) - 1, file);
+    text[size] = '\0';
+    fclose(file);
+    remove(TRACE_PATH);
+    printf("trace-event json: %s\n", strncmp(text, "{\"traceEvents\":[", 16) == 0 ? "yes" : "no");
+    for (int i = 0; i < 3; i++)
+    {
+        printf("thread %d has runs: %s, other events: %s\n", i + 1,
+               contains(text, "\"tid\":%d,\"args\":{\"carrier\"", tids[i]) ? "yes" : "no",
+               contains(text, "\"tid\":%d,\"args\":{\"by\"", tids[i]) ? "yes" : "no");
+    }
+    uthread_terminate(0);
+    return 0;
+}
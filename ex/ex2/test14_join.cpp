@@ -0,0 +1,104 @@
+/*
+ * test14_join.cpp - Fork-join: every call of a recursive Fibonacci spawns its two halves as joinable threads and joins
+ * them. Then a thread joined before and after it ends, a terminated one, detached ones and the errors of uthread_join.
+ *
+ * Output should be the same as test14_join.txt.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include "uthreads.h"
+
+#define FIB_N 12
+#define MAX_THREADS 1024
+
+static volatile int release = 0;
+
+void* fib(void* arg)
+{
+    intptr_t n = (intptr_t) arg;
+    if (n < 2)
+    {
+        return (void*) n;
+    }
+    int left = uthread_spawn_arg(fib, (void*) (n - 1));
+    int right = uthread_spawn_arg(fib, (void*) (n - 2));
+    void* a;
+    void* b;
+    if (left < 0 || right < 0 || uthread_join(left, &a) != 0 || uthread_join(right, &b) != 0)
+    {
+        return (void*) -1;
+    }
+    return (void*) ((intptr_t) a + (intptr_t) b);
+}
+
+void* wait_for_release(void* arg)
+{
+    while (!release)
+    {
+        uthread_yield();
+    }
+    return arg;
+}
+
+/*
+ * Joins the main thread, or the calling thread itself if arg is null.
+ */
+void* try_join(void* arg)
+{
+    int tid = arg == nullptr ? uthread_get_tid() : 0;
+    return (void*) (intptr_t) uthread_join(tid, nullptr);
+}
+
+int main()
+{
+    uthread_init(1000, MAX_THREADS);
+
+    void* result;
+    int tid = uthread_spawn_arg(fib, (void*) FIB_N);
+    printf("join fib(%d) returns %d\n", FIB_N, uthread_join(tid, &result));
+    printf("fib(%d) = %ld\n", FIB_N, (long) (intptr_t) result);
+
+    // Joined while it runs, and joined after it ended
+    tid = uthread_spawn_arg(wait_for_release, (void*) 7);
+    release = 1;
+    printf("join a running thread returns %d\n", uthread_join(tid, &result));
+    printf("its result is %ld\n", (long) (intptr_t) result);
+    tid = uthread_spawn_arg(wait_for_release, (void*) 8);
+    uthread_yield();
+    printf("join an ended thread returns %d\n", uthread_join(tid, &result));
+    printf("its result is %ld\n", (long) (intptr_t) result);
+    printf("join it again returns %d\n", uthread_join(tid, &result));
+
+    // A terminated thread ends with a null result
+    release = 0;
+    tid = uthread_spawn_arg(wait_for_release, (void*) 9);
+    printf("terminate returns %d\n", uthread_terminate(tid));
+    result = (void*) 1;
+    printf("join a terminated thread returns %d\n", uthread_join(tid, &result));
+    printf("its result is null: %s\n", result == nullptr ? "yes" : "no");
+
+    // Detached before and after it ends
+    tid = uthread_spawn_arg(wait_for_release, nullptr);
+    printf("detach a running thread returns %d\n", uthread_detach(tid));
+    printf("join a detached thread returns %d\n", uthread_join(tid, nullptr));
+    release = 1;
+    uthread_yield();
+    tid = uthread_spawn_arg(wait_for_release, nullptr);
+    uthread_yield();
+    printf("detach an ended thread returns %d\n", uthread_detach(tid));
+    printf("detach it again returns %d\n", uthread_detach(tid));
+
+    // Errors
+    int plain = uthread_spawn_ex(wait_for_release, nullptr, nullptr);
+    printf("join a thread that is not joinable returns %d\n", uthread_join(plain, nullptr));
+    tid = uthread_spawn_arg(try_join, (void*) 1);
+    uthread_join(tid, &result);
+    printf("join the main thread returns %ld\n", (long) (intptr_t) result);
+    tid = uthread_spawn_arg(try_join, nullptr);
+    uthread_join(tid, &result);
+    printf("join itself returns %ld\n", (long) (intptr_t) result);
+
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * test15_coroutines.cpp - Coroutine tasks run by the uthread scheduler: tasks awaiting tasks (with a result and with an
+ * exception), coroutines that sleep and wake up in deadline order, one receiving from a channel a stackful thread
+ * sends on, one waiting for a pipe a stackful thread writes to, and many coroutines sleeping at once.
+ *
+ * Output should be the same as test15_coroutines.txt.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+#include "coroutine.h"
+#include "uthreads.h"
+
+#define SLEEPERS 3
+#define SLEEP_STEP_NSECS 10000000ULL
+#define VALUES 5
+#define MANY 100000
+#define MANY_SLEEP_NSECS 1000000ULL
+
+static std::atomic<int> done(0);
+static int wake_order[SLEEPERS];
+static std::atomic<int> woken(0);
+static uthread_channel channel;
+static int pipe_fds[2];
+static std::atomic<int> many_done(0);
+
+uthread::task<int> square(int x)
+{
+    co_await uthread::yield();
+    co_return x * x;
+}
+
+uthread::task<int> fail()
+{
+    co_await uthread::yield();
+    throw std::runtime_error("failed");
+}
+
+uthread::task<> fork_join()
+{
+    int sum = 0;
+    for (int i = 1; i <= 4; i++)
+    {
+        sum += co_await square(i);
+    }
+    printf("sum of squares: %d\n", sum);
+    try
+    {
+        co_await fail();
+        printf("no exception\n");
+    }
+    catch (const std::runtime_error& e)
+    {
+        printf("caught: %s\n", e.what());
+    }
+    done++;
+}
+
+uthread::task<> sleeper(int id)
+{
+    co_await uthread::sleep_for((SLEEPERS - id) * SLEEP_STEP_NSECS);
+    wake_order[woken++] = id;
+    done++;
+}
+
+uthread::task<> receiver()
+{
+    void* value;
+    long sum = 0;
+    int received = 0;
+    int result;
+    while ((result = co_await uthread::receive(&channel, &value)) == 0)
+    {
+        sum += (long) (intptr_t) value;
+        received++;
+    }
+    printf("received %d values, sum %ld, then %d\n", received, sum, result);
+    done++;
+}
+
+uthread::task<> pipe_reader()
+{
+    char buffer[16] = {};
+    int ready = co_await uthread::readable(pipe_fds[0]);
+    ssize_t size = read(pipe_fds[0], buffer, sizeof(buffer) - 1);
+    printf("pipe readable returns %d, read \"%s\" (%zd bytes)\n", ready, buffer, size);
+    done++;
+}
+
+uthread::task<> many_sleeper()
+{
+    co_await uthread::sleep_for(MANY_SLEEP_NSECS);
+    many_done++;
+}
+
+void* sender(void*)
+{
+    for (int i = 1; i <= VALUES; i++)
+    {
+        uthread_channel_send(&channel, (void*) (intptr_t) i);
+    }
+    uthread_channel_close(&channel);
+    return nullptr;
+}
+
+void* pipe_writer(void*)
+{
+    uthread_sleep(2);
+    write(pipe_fds[1], "hello", 5);
+    return nullptr;
+}
+
+static void wait_for(std::atomic<int>& counter, int target)
+{
+    while (counter < target)
+    {
+        uthread_yield();
+    }
+}
+
+int main()
+{
+    uthread_init(1000);
+
+    uthread::spawn(fork_join());
+    wait_for(done, 1);
+
+    for (int i = 0; i < SLEEPERS; i++)
+    {
+        uthread::spawn(sleeper(i));
+    }
+    wait_for(done, 1 + SLEEPERS);
+    printf("sleepers woke up in order:");
+    for (int i = 0; i < SLEEPERS; i++)
+    {
+        printf(" %d", wake_order[i]);
+    }
+    printf("\n");
+
+    uthread_channel_init(&channel, 0);
+    uthread::spawn(receiver());
+    uthread_spawn_ex(sender, nullptr, nullptr);
+    wait_for(done, 2 + SLEEPERS);
+    uthread_channel_destroy(&channel);
+
+    pipe(pipe_fds);
+    fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK);
+    uthread::spawn(pipe_reader());
+    uthread_spawn_ex(pipe_writer, nullptr, nullptr);
+    wait_for(done, 3 + SLEEPERS);
+
+    for (int i = 0; i < MANY; i++)
+    {
+        uthread::spawn(many_sleeper());
+    }
+    wait_for(many_done, MANY);
+    printf("%d coroutines slept and woke up\n", MANY);
+
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * test16_spawn_many.cpp - Threads spawned in one batch with uthread_spawn_many: they get the IDs and run in the order
+ * uthread_spawn would give them, a batch that does not fit creates no thread at all, and the errors of the call.
+ *
+ * Output should be the same as test16_spawn_many.txt.
+ */
+
+#include <cstdio>
+#include "uthreads.h"
+
+#define BATCH 4
+#define MAX_THREADS 8
+
+static int finished = 0;
+
+void first()
+{
+    printf("first is thread %d\n", uthread_get_tid());
+    finished++;
+    uthread_terminate(uthread_get_tid());
+}
+
+void second()
+{
+    printf("second is thread %d\n", uthread_get_tid());
+    finished++;
+    uthread_terminate(uthread_get_tid());
+}
+
+void spin()
+{
+    while (true)
+    {
+        uthread_yield();
+    }
+}
+
+int main()
+{
+    uthread_init(10000000, MAX_THREADS);
+
+    thread_entry_point entries[MAX_THREADS] = {first, second, first, second};
+    int tids[MAX_THREADS];
+    printf("spawn_many returns %d\n", uthread_spawn_many(entries, BATCH, tids));
+    printf("IDs:");
+    for (int i = 0; i < BATCH; i++)
+    {
+        printf(" %d", tids[i]);
+    }
+    printf("\n");
+    while (finished < BATCH)
+    {
+        uthread_yield();
+    }
+
+    // Only MAX_THREADS - 1 threads fit next to the main thread
+    for (int i = 0; i < MAX_THREADS; i++)
+    {
+        entries[i] = spin;
+    }
+    printf("spawn_many of %d threads returns %d\n", MAX_THREADS, uthread_spawn_many(entries, MAX_THREADS, tids));
+    printf("spawn after it returns %d\n", uthread_spawn(first));
+    while (finished < BATCH + 1)
+    {
+        uthread_yield();
+    }
+
+    printf("spawn_many of 0 threads returns %d\n", uthread_spawn_many(entries, 0, tids));
+    entries[1] = nullptr;
+    printf("spawn_many with a null entry point returns %d\n", uthread_spawn_many(entries, 2, tids));
+    printf("spawn_many without tids_out returns %d\n", uthread_spawn_many(entries, 1, nullptr));
+
+    uthread_terminate(0);
+    return 0;
+}
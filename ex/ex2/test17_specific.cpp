@@ -0,0 +1,102 @@
+/*
+ * test17_specific.cpp - Thread-specific data: threads that keep their own values for the same keys, destructors run
+ * when a thread returns or terminates itself (again for a value a destructor sets), none for a thread terminated by
+ * another one, and the errors of the calls.
+ *
+ * Output should be the same as test17_specific.txt.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include "uthreads.h"
+
+static uthread_key name_key;
+static uthread_key count_key;
+static uthread_key again_key;
+static volatile int release = 0;
+
+static void destroy_name(void* value)
+{
+    printf("thread %d: destroy name %s\n", uthread_get_tid(), (const char*) value);
+}
+
+static void destroy_again(void* value)
+{
+    intptr_t rounds = (intptr_t) value;
+    printf("thread %d: destroy again %ld\n", uthread_get_tid(), (long) rounds);
+    if (rounds > 1)
+    {
+        uthread_setspecific(again_key, (void*) (rounds - 1));
+    }
+}
+
+void* worker(void* arg)
+{
+    printf("thread %d: name before set is null: %s\n", uthread_get_tid(),
+           uthread_getspecific(name_key) == nullptr ? "yes" : "no");
+    uthread_setspecific(name_key, arg);
+    uthread_setspecific(count_key, (void*) (intptr_t) uthread_get_tid());
+    uthread_yield();
+    printf("thread %d: name %s, count %ld\n", uthread_get_tid(), (const char*) uthread_getspecific(name_key),
+           (long) (intptr_t) uthread_getspecific(count_key));
+    return nullptr;
+}
+
+void* terminates_itself(void*)
+{
+    uthread_setspecific(name_key, "self");
+    uthread_setspecific(again_key, (void*) 6);
+    uthread_terminate(uthread_get_tid());
+    return nullptr;
+}
+
+void* terminated(void*)
+{
+    uthread_setspecific(name_key, "killed");
+    while (!release)
+    {
+        uthread_yield();
+    }
+    return nullptr;
+}
+
+int main()
+{
+    uthread_init(10000000);
+
+    uthread_key_create(&name_key, destroy_name);
+    uthread_key_create(&count_key, nullptr);
+    uthread_key_create(&again_key, destroy_again);
+    printf("keys: %d %d %d\n", name_key, count_key, again_key);
+
+    uthread_setspecific(name_key, "main");
+    int a = uthread_spawn_arg(worker, (void*) "a");
+    int b = uthread_spawn_arg(worker, (void*) "b");
+    uthread_join(a, nullptr);
+    uthread_join(b, nullptr);
+    printf("main: name %s\n", (const char*) uthread_getspecific(name_key));
+
+    int self = uthread_spawn_arg(terminates_itself, nullptr);
+    uthread_join(self, nullptr);
+
+    int killed = uthread_spawn_arg(terminated, nullptr);
+    uthread_yield();
+    uthread_terminate(killed);
+    uthread_join(killed, nullptr);
+    printf("terminated by main\n");
+
+    // Errors
+    printf("getspecific of a key not created is null: %s\n",
+           uthread_getspecific(UTHREAD_KEYS_MAX) == nullptr ? "yes" : "no");
+    printf("setspecific of a key not created returns %d\n", uthread_setspecific(-1, nullptr));
+    uthread_key key;
+    int created = 3;
+    while (uthread_key_create(&key, nullptr) == 0)
+    {
+        created++;
+    }
+    printf("created %d keys\n", created);
+
+    uthread_terminate(0);
+    return 0;
+}
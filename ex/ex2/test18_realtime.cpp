@@ -0,0 +1,125 @@
+/*
+ * test18_realtime.cpp - The real-time class: a CPU bound real-time thread gets its budget every period, and no more,
+ * ahead of CPU bound round-robin threads; a real-time thread woken up by a semaphore preempts the thread that posted it
+ * right away; a sleeping one runs first in the quantum it wakes up at; admission control and the errors of
+ * uthread_set_realtime.
+ *
+ * Output should be the same as test18_realtime.txt.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include "uthreads.h"
+
+#define RUN_QUANTA 800
+#define PERIOD 10
+#define BUDGET 5
+#define WAKEUPS 20
+
+static uthread_sem sem;
+static std::atomic<int> posted(0);
+static std::atomic<int> woken(0);
+static int late_wakeups = 0;
+
+void spin()
+{
+    while (true)
+    {
+    }
+}
+
+void waiter()
+{
+    while (true)
+    {
+        uthread_sem_wait(&sem);
+        woken = posted.load();
+    }
+}
+
+void poster()
+{
+    while (true)
+    {
+        posted++;
+        uthread_sem_post(&sem);
+        if (woken != posted)
+        {
+            printf("the waiter did not run before sem_post returned\n");
+        }
+        uthread_yield();
+    }
+}
+
+void sleeper()
+{
+    for (int i = 0; i < WAKEUPS; i++)
+    {
+        int before = uthread_get_total_quantums();
+        uthread_sleep(2);
+        // Woken up at the start of the third quantum from now, and run in it
+        if (uthread_get_total_quantums() != before + 3)
+        {
+            late_wakeups++;
+        }
+    }
+    uthread_terminate(uthread_get_tid());
+}
+
+static void run_for(int quanta)
+{
+    int end = uthread_get_total_quantums() + quanta;
+    while (uthread_get_total_quantums() < end)
+    {
+    }
+}
+
+int main()
+{
+    uthread_init(1000);
+
+    // Errors and admission control
+    int a = uthread_spawn(spin);
+    int b = uthread_spawn(spin);
+    printf("budget above the deadline returns %d\n", uthread_set_realtime(a, 10, 6, 5));
+    printf("deadline above the period returns %d\n", uthread_set_realtime(a, 10, 5, 20));
+    printf("a missing thread returns %d\n", uthread_set_realtime(-1, 10, 5, 0));
+    printf("50%% of the CPU returns %d\n", uthread_set_realtime(a, PERIOD, BUDGET, 0));
+    printf("another 50%% returns %d\n", uthread_set_realtime(b, PERIOD, BUDGET, 0));
+    printf("another 40%% returns %d\n", uthread_set_realtime(b, PERIOD, 4, 0));
+    printf("back to round-robin returns %d\n", uthread_set_realtime(b, 0, 0, 0));
+
+    // a is real-time, b and the main thread are round-robin
+    int start_a = uthread_get_quantums(a);
+    int start_b = uthread_get_quantums(b);
+    run_for(RUN_QUANTA);
+    double a_share = (double) (uthread_get_quantums(a) - start_a) / RUN_QUANTA;
+    double b_share = (double) (uthread_get_quantums(b) - start_b) / RUN_QUANTA;
+    printf("the real-time thread ran half of the time: %s\n", a_share > 0.45 && a_share < 0.55 ? "yes" : "no");
+    printf("the round-robin thread ran a quarter of the time: %s\n", b_share > 0.2 && b_share < 0.3 ? "yes" : "no");
+    uthread_terminate(a);
+    uthread_terminate(b);
+
+    // Woken up by a round-robin thread
+    uthread_sem_init(&sem, 0);
+    int w = uthread_spawn(waiter);
+    uthread_set_realtime(w, PERIOD, PERIOD - 1, 0);
+    int p = uthread_spawn(poster);
+    run_for(50);
+    printf("the waiter saw every post: %s\n", posted > 0 && woken == posted ? "yes" : "no");
+    uthread_terminate(p);
+    uthread_terminate(w);
+
+    // Woken up from a sleep while round-robin threads spin
+    uthread_spawn(spin);
+    uthread_spawn(spin);
+    int s = uthread_spawn(sleeper);
+    uthread_set_realtime(s, 3, 1, 0);
+    while (uthread_get_quantums(s) >= 0)
+    {
+    }
+    printf("late wakeups: %d\n", late_wakeups);
+
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * test19_coroutine_churn.cpp - Coroutines spawned while earlier ones finish: the main thread allocates frames while the
+ * coroutine runner frees them on the same carrier, with a quantum short enough that both are preempted in the middle
+ * of the allocator over and over. Every coroutine must run, and the heap must stay intact.
+ *
+ * Output should be the same as test19_coroutine_churn.txt.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include "coroutine.h"
+#include "uthreads.h"
+
+#define ROUNDS 50
+#define PER_ROUND 20000
+
+static std::atomic<int> finished(0);
+
+uthread::task<int> twice(int x)
+{
+    co_await uthread::yield();
+    co_return 2 * x;
+}
+
+uthread::task<> worker(int id)
+{
+    // Allocates the frame of the task it awaits, and frees it, while the main thread allocates the next ones
+    int result = co_await twice(id);
+    if (result != 2 * id)
+    {
+        printf("coroutine %d got %d\n", id, result);
+    }
+    finished++;
+}
+
+int main()
+{
+    uthread_init(100);
+
+    int spawned = 0;
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        for (int i = 0; i < PER_ROUND; i++)
+        {
+            if (uthread::spawn(worker(spawned)) < 0)
+            {
+                printf("spawn failed\n");
+                exit(1);
+            }
+            spawned++;
+        }
+        // Let part of the round finish, so the next one allocates while the rest is freed
+        while (finished < spawned - PER_ROUND / 2)
+        {
+            uthread_yield();
+        }
+    }
+    while (finished < spawned)
+    {
+        uthread_yield();
+    }
+    printf("%d coroutines spawned while others finished\n", spawned);
+
+    uthread_terminate(0);
+    return 0;
+}
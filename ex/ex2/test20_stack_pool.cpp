@@ -0,0 +1,217 @@
+/*
+ * test20_stack_pool.cpp - The stack pool: a thread that overflows its stack faults on the guard page below it instead
+ * of writing over the stack of the thread carved next to it (in a child process, which catches the fault on an
+ * alternate signal stack); a terminated thread's stack is handed to the next thread without a new mapping; and once
+ * enough stacks were released, the stacks that stayed idle give their memory back, but for the hot ones.
+ *
+ * Output should be the same as test20_stack_pool.txt.
+ */
+
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "stack_pool.h"
+#include "uthreads.h"
+
+#define CANARY_SIZE 256
+#define CANARY 0x5a
+#define BURST (STACK_POOL_HOT_STACKS + 16)
+#define CHURN (2 * STACK_POOL_TRIM_PERIOD)
+
+static volatile char* canary = nullptr;
+static char* stack_addresses[BURST + 1];
+static int recorded = 0;
+static int finished = 0;
+static volatile int release = 0;
+
+/*
+ * Uses about depth KiB of stack.
+ */
+static int use_stack(int depth)
+{
+    volatile char frame[1024];
+    memset((char*) frame, depth, sizeof(frame));
+    return depth == 0 ? 0 : frame[0] + use_stack(depth - 1);
+}
+
+static void report(const char* message)
+{
+    write(STDOUT_FILENO, message, strlen(message));
+}
+
+static void on_fault(int)
+{
+    bool intact = true;
+    for (int i = 0; i < CANARY_SIZE; i++)
+    {
+        intact = intact && canary[i] == CANARY;
+    }
+    report(intact ? "the overflow faulted and the neighbour's stack is intact\n"
+                  : "the overflow wrote over the neighbour's stack\n");
+    _exit(0);
+}
+
+void neighbour()
+{
+    volatile char frame[CANARY_SIZE];
+    memset((char*) frame, CANARY, sizeof(frame));
+    canary = frame;
+    while (true)
+    {
+        uthread_yield();
+    }
+}
+
+void overflow()
+{
+    use_stack(1024 * 1024);
+    report("the overflow did not fault\n");
+    _exit(1);
+}
+
+static void overflow_child()
+{
+    static char alternate[64 * 1024];
+    stack_t signal_stack = {};
+    signal_stack.ss_sp = alternate;
+    signal_stack.ss_size = sizeof(alternate);
+    sigaltstack(&signal_stack, nullptr);
+    struct sigaction action = {};
+    action.sa_handler = on_fault;
+    action.sa_flags = SA_ONSTACK;
+    sigaction(SIGSEGV, &action, nullptr);
+
+    uthread_init(10000000);
+    // Carved one after the other, so the overflowing thread's guard page is right above the neighbour's stack
+    uthread_spawn(neighbour);
+    uthread_spawn(overflow);
+    while (true)
+    {
+        uthread_yield();
+    }
+}
+
+static int count_mappings()
+{
+    FILE* maps = fopen("/proc/self/maps", "r");
+    int lines = 0;
+    int c;
+    while ((c = fgetc(maps)) != EOF)
+    {
+        lines += c == '\n';
+    }
+    fclose(maps);
+    return lines;
+}
+
+static bool resident(char* address)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    unsigned char in_core = 0;
+    mincore((void*) ((uintptr_t) address & ~(page_size - 1)), page_size, &in_core);
+    return in_core & 1;
+}
+
+void recorder()
+{
+    volatile char local = 0;
+    stack_addresses[recorded++] = (char*) &local;
+    finished++;
+    uthread_terminate(uthread_get_tid());
+}
+
+void holder()
+{
+    volatile char local = 0;
+    stack_addresses[recorded++] = (char*) &local;
+    while (!release)
+    {
+        uthread_yield();
+    }
+    finished++;
+    uthread_terminate(uthread_get_tid());
+}
+
+void short_lived()
+{
+    finished++;
+    uthread_terminate(uthread_get_tid());
+}
+
+static void wait_for_finished(int count)
+{
+    while (finished < count)
+    {
+        uthread_yield();
+    }
+}
+
+int main()
+{
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0)
+    {
+        overflow_child();
+    }
+    int status;
+    waitpid(child, &status, 0);
+    printf("the child exited with %d\n", WIFEXITED(status) ? WEXITSTATUS(status) : -WTERMSIG(status));
+
+    uthread_init(10000000);
+
+    // Reuse
+    uthread_spawn(recorder);
+    wait_for_finished(1);
+    int mappings = count_mappings();
+    uthread_spawn(recorder);
+    wait_for_finished(2);
+    printf("the next thread got the terminated thread's stack: %s\n",
+           stack_addresses[0] == stack_addresses[1] ? "yes" : "no");
+    printf("without a new mapping: %s\n", count_mappings() == mappings ? "yes" : "no");
+
+    // Trimming: a burst of threads, then threads that start and end one at a time, which keep reusing one stack
+    recorded = 0;
+    finished = 0;
+    for (int i = 0; i < BURST; i++)
+    {
+        uthread_spawn(holder);
+    }
+    while (recorded < BURST)
+    {
+        uthread_yield();
+    }
+    release = 1;
+    wait_for_finished(BURST);
+    int burst_resident = 0;
+    for (int i = 0; i < BURST; i++)
+    {
+        burst_resident += resident(stack_addresses[i]);
+    }
+    printf("the burst's stacks have their memory: %s\n", burst_resident == BURST ? "yes" : "no");
+
+    mappings = count_mappings();
+    for (int i = 0; i < CHURN; i++)
+    {
+        uthread_spawn(short_lived);
+        wait_for_finished(BURST + i + 1);
+    }
+    printf("%d threads started and ended without a new mapping: %s\n", CHURN,
+           count_mappings() == mappings ? "yes" : "no");
+    int still_resident = 0;
+    for (int i = 0; i < BURST; i++)
+    {
+        still_resident += resident(stack_addresses[i]);
+    }
+    // The stack the churn reuses is one of the burst's, and is never idle
+    printf("idle stacks kept their memory: %d of %d (%d hot ones and the reused one)\n", still_resident, BURST,
+           STACK_POOL_HOT_STACKS);
+
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*
+ * test21_run_queue.cpp - READY threads taken out of the middle of the run queue, by uthread_block and by
+ * uthread_terminate from another thread: the others keep their round-robin order, and a resumed thread goes to the
+ * back. The quantum is long enough for the timer never to expire, so the order is decided by the yields alone.
+ *
+ * Output should be the same as test21_run_queue.txt.
+ */
+
+#include <cstdio>
+#include "uthreads.h"
+
+#define WORKERS 5
+
+static int order[WORKERS];
+static int ran = 0;
+
+void worker()
+{
+    while (true)
+    {
+        order[ran++] = uthread_get_tid();
+        uthread_yield();
+    }
+}
+
+/*
+ * Lets every READY thread run once and prints the order they ran in.
+ */
+static void round(const char* name)
+{
+    ran = 0;
+    uthread_yield();
+    printf("%s:", name);
+    for (int i = 0; i < ran; i++)
+    {
+        printf(" %d", order[i]);
+    }
+    printf("\n");
+}
+
+int main()
+{
+    uthread_init(10000000);
+    for (int i = 0; i < WORKERS; i++)
+    {
+        uthread_spawn(worker);
+    }
+
+    round("all of them");
+    uthread_block(3);
+    round("3 blocked");
+    uthread_terminate(2);
+    round("2 terminated");
+    uthread_resume(3);
+    round("3 resumed");
+    uthread_terminate(5);
+    uthread_block(1);
+    round("5 terminated and 1 blocked");
+    uthread_resume(1);
+    round("1 resumed");
+
+    uthread_terminate(0);
+    return 0;
+}
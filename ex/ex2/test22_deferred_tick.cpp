@@ -0,0 +1,86 @@
+/*
+ * test22_deferred_tick.cpp - A tick that comes in while preemption is disabled: the running thread spins inside a
+ * critical section for several quanta, as a long library call would, and keeps the CPU; when the section ends the
+ * tick is replayed exactly once, so one quantum starts, the other thread runs for it, and the spinning thread runs
+ * again right after.
+ *
+ * Output should be the same as test22_deferred_tick.txt.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <sys/resource.h>
+#include "preempt.h"
+#include "uthreads.h"
+
+#define QUANTUM_USECS 20000
+#define SECTION_QUANTA 3
+#define ROUNDS 3
+
+static std::atomic<int> worker_saw(-1);
+static volatile int spin_sink;
+
+void worker()
+{
+    while (true)
+    {
+        worker_saw = uthread_get_total_quantums();
+    }
+}
+
+static long user_usecs()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec * 1000000L + usage.ru_utime.tv_usec;
+}
+
+/*
+ * Spins for usecs of user CPU time, which is what the timer counts.
+ */
+static void spin_user_usecs(long usecs)
+{
+    long start = user_usecs();
+    while (user_usecs() - start < usecs)
+    {
+        for (int i = 0; i < 100000; i++)
+        {
+            spin_sink = i;
+        }
+    }
+}
+
+int main()
+{
+    uthread_init(QUANTUM_USECS);
+    int tid = uthread_spawn(worker);
+    uthread_yield();
+
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        int main_quanta = uthread_get_quantums(0);
+        int worker_quanta = uthread_get_quantums(tid);
+
+        preempt_disable();
+        int start = uthread_get_total_quantums();
+        spin_user_usecs(SECTION_QUANTA * QUANTUM_USECS);
+        bool kept_cpu = uthread_get_total_quantums() == start && worker_saw < start;
+        preempt_enable();
+        // The replayed tick switches right away, but give it a few more quanta of CPU time before looking
+        long waited_since = user_usecs();
+        while (uthread_get_total_quantums() < start + 2 && user_usecs() - waited_since < SECTION_QUANTA * QUANTUM_USECS)
+        {
+            spin_sink = 0;
+        }
+
+        // The replayed tick started quantum start + 1 for the worker, and the next tick gave the CPU back
+        printf("round %d: kept the CPU in the section: %s, quanta started after it: %d, worker ran in the next one: %s,"
+               " quanta of main +%d, of the worker +%d\n",
+               round, kept_cpu ? "yes" : "no", uthread_get_total_quantums() - start,
+               worker_saw == start + 1 ? "yes" : "no", uthread_get_quantums(0) - main_quanta,
+               uthread_get_quantums(tid) - worker_quanta);
+    }
+
+    uthread_terminate(0);
+    return 0;
+}
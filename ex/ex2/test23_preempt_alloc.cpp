@@ -0,0 +1,70 @@
+/*
+ * test23_preempt_alloc.cpp - Threads that allocate and free all the time, with a quantum short enough that they would
+ * be preempted in the middle of the allocator over and over, but do it between uthread_preempt_disable and
+ * uthread_preempt_enable: the heap must stay intact. The calls must not nest.
+ *
+ * Output should be the same as test23_preempt_alloc.txt.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "uthreads.h"
+
+#define QUANTUM_USECS 100
+#define ALLOCATORS 4
+#define ROUNDS 1000000
+#define SLOTS 64
+
+static std::atomic<int> finished(0);
+static bool intact = true;
+
+void allocator()
+{
+    int tid = uthread_get_tid();
+    char* slots[SLOTS] = {};
+    for (int i = 0; i < ROUNDS; i++)
+    {
+        int slot = (i * 7 + tid) % SLOTS;
+        size_t size = 16 + (i * 37 + tid) % 512;
+        uthread_preempt_disable();
+        free(slots[slot]);
+        slots[slot] = (char*) malloc(size);
+        uthread_preempt_enable();
+        memset(slots[slot], tid, size);
+        intact = intact && slots[slot][size - 1] == tid;
+    }
+    uthread_preempt_disable();
+    for (int i = 0; i < SLOTS; i++)
+    {
+        free(slots[i]);
+    }
+    uthread_preempt_enable();
+    finished++;
+    uthread_terminate(tid);
+}
+
+int main()
+{
+    printf("before uthread_init: %d %d\n", uthread_preempt_disable(), uthread_preempt_enable());
+    uthread_init(QUANTUM_USECS);
+
+    printf("enable without disable returns %d\n", uthread_preempt_enable());
+    uthread_preempt_disable();
+    printf("disable twice returns %d\n", uthread_preempt_disable());
+    uthread_preempt_enable();
+
+    for (int i = 0; i < ALLOCATORS; i++)
+    {
+        uthread_spawn(allocator);
+    }
+    while (finished < ALLOCATORS)
+    {
+        uthread_yield();
+    }
+    printf("%d threads allocated %d times each, heap intact: %s\n", ALLOCATORS, ROUNDS, intact ? "yes" : "no");
+
+    uthread_terminate(0);
+    return 0;
+}
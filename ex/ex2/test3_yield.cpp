@@ -0,0 +1,41 @@
+/*
+ * test3_yield.cpp - Threads that give up the CPU with uthread_yield. The quantum is long enough for the timer never
+ * to expire, so the order is decided by the yields alone.
+ *
+ * Output should be the same as test3_yield.txt.
+ */
+
+#include <cstdio>
+#include "uthreads.h"
+
+#define STEPS 3
+
+void worker()
+{
+    int tid = uthread_get_tid();
+    for (int i = 0; i < STEPS; i++)
+    {
+        printf("thread %d step %d quanta %d\n", tid, i, uthread_get_quantums(tid));
+        uthread_yield();
+    }
+    printf("thread %d done\n", tid);
+    uthread_terminate(tid);
+}
+
+int main()
+{
+    uthread_init(10000000);
+    uthread_spawn(worker);
+    uthread_spawn(worker);
+
+    for (int i = 0; i <= STEPS; i++)
+    {
+        printf("thread 0 step %d quanta %d\n", i, uthread_get_quantums(0));
+        uthread_yield();
+    }
+    // Both workers are gone, so this yield returns right away
+    uthread_yield();
+    printf("total quanta %d\n", uthread_get_total_quantums());
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * test4_sleep.cpp - Threads sleeping for different numbers of quanta wake up in the order of their deadlines, and
+ * report how many quanta after going to sleep they ran again.
+ *
+ * Output should be the same as test4_sleep.txt.
+ */
+
+#include <cstdio>
+#include "uthreads.h"
+
+int sleep_quanta[] = {0, 3, 1, 2};
+int done = 0;
+
+void sleeper()
+{
+    int tid = uthread_get_tid();
+    int start = uthread_get_total_quantums();
+    uthread_sleep(sleep_quanta[tid]);
+    printf("thread %d slept %d ran again after %d quanta\n", tid, sleep_quanta[tid],
+           uthread_get_total_quantums() - start);
+    done++;
+    uthread_terminate(tid);
+}
+
+int main()
+{
+    uthread_init(1000);
+    for (int i = 1; i <= 3; i++)
+    {
+        uthread_spawn(sleeper);
+    }
+    while (*(volatile int*) &done < 3)
+    {
+    }
+    printf("all woke\n");
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ * test5_spawn_ex.cpp - Threads spawned with an argument and their own stack attributes: a small stack, a lazily
+ * reserved 4 MiB stack that is mostly used, a committed 1 MiB stack and the defaults. The quantum is long enough for
+ * the timer never to expire.
+ *
+ * Output should be the same as test5_spawn_ex.txt.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include "uthreads.h"
+
+#define LARGE_STACK (4 * 1024 * 1024)
+
+static int finished = 0;
+
+/*
+ * Uses about depth KiB of stack.
+ */
+static int use_stack(int depth)
+{
+    volatile char frame[1024];
+    memset((char*) frame, depth, sizeof(frame));
+    return depth == 0 ? 0 : frame[0] + use_stack(depth - 1);
+}
+
+void* worker(void* arg)
+{
+    const char* name = (const char*) arg;
+    int used = 0;
+    if (strcmp(name, "large") == 0)
+    {
+        used = 3 * 1024;
+        use_stack(used);
+    }
+    printf("thread %d (%s) used %d KiB of stack\n", uthread_get_tid(), name, used);
+    finished++;
+    return nullptr;
+}
+
+int main()
+{
+    uthread_init(10000000);
+
+    uthread_attr attr;
+    uthread_attr_init(&attr);
+    attr.stack_size = 256;
+    uthread_spawn_ex(worker, (void*) "small", &attr);
+
+    attr.stack_size = LARGE_STACK;
+    uthread_spawn_ex(worker, (void*) "large", &attr);
+
+    attr.stack_size = 1024 * 1024;
+    attr.lazy_stack = 0;
+    uthread_spawn_ex(worker, (void*) "committed", &attr);
+
+    uthread_spawn_ex(worker, (void*) "default", nullptr);
+
+    attr.stack_size = MAX_STACK_SIZE + 1;
+    printf("spawn with a stack above MAX_STACK_SIZE returns %d\n", uthread_spawn_ex(worker, nullptr, &attr));
+
+    while (finished < 4)
+    {
+        uthread_yield();
+    }
+    printf("all finished\n");
+    uthread_terminate(0);
+    return 0;
+}
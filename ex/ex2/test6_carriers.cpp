@@ -0,0 +1,101 @@
+/*
+ * test6_carriers.cpp - CPU bound threads on four carriers. Every thread adds up a range of numbers, yielding and
+ * sleeping now and then, while the main thread blocks and resumes them wherever they run. The sums must come out
+ * right, and the threads must have run on more than one kernel thread.
+ *
+ * Output should be the same as test6_carriers.txt.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <unistd.h>
+#include "uthreads.h"
+
+#define CARRIERS 4
+#define WORKERS 16
+#define NUMBERS 3000000L
+
+static std::atomic<int> finished(0);
+static long sums[WORKERS];
+
+// the kernel threads any worker ran on
+static std::atomic<pid_t> kernel_threads[CARRIERS];
+
+static void record_kernel_thread()
+{
+    pid_t tid = gettid();
+    for (int i = 0; i < CARRIERS; i++)
+    {
+        pid_t seen = 0;
+        if (kernel_threads[i].compare_exchange_strong(seen, tid) || seen == tid)
+        {
+            return;
+        }
+    }
+}
+
+void* worker(void* arg)
+{
+    long index = (long) arg;
+    long sum = 0;
+    for (long i = 1; i <= NUMBERS; i++)
+    {
+        sum += i;
+        if (i % 100000 == 0)
+        {
+            record_kernel_thread();
+            if (i % 1000000 == 0)
+            {
+                uthread_sleep(1);
+            }
+            else
+            {
+                uthread_yield();
+            }
+        }
+    }
+    sums[index] = sum;
+    finished++;
+    // Stay alive until the main thread is done blocking and resuming the threads
+    while (true)
+    {
+        uthread_yield();
+    }
+}
+
+int main()
+{
+    uthread_init(1000, MAX_THREAD_NUM, CARRIERS);
+
+    int tids[WORKERS];
+    for (long i = 0; i < WORKERS; i++)
+    {
+        tids[i] = uthread_spawn_ex(worker, (void*) i, nullptr);
+    }
+
+    int round = 0;
+    while (finished < WORKERS)
+    {
+        int tid = tids[round++ % WORKERS];
+        if (uthread_block(tid) == 0)
+        {
+            uthread_resume(tid);
+        }
+        uthread_yield();
+    }
+
+    bool correct = true;
+    for (int i = 0; i < WORKERS; i++)
+    {
+        correct = correct && sums[i] == NUMBERS * (NUMBERS + 1) / 2;
+    }
+    int used = 0;
+    for (int i = 0; i < CARRIERS; i++)
+    {
+        used += kernel_threads[i] != 0;
+    }
+    printf("%d threads finished, sums %s\n", WORKERS, correct ? "correct" : "wrong");
+    printf("ran on more than one kernel thread: %s\n", used > 1 ? "yes" : "no");
+    uthread_terminate(0);
+    return 0;
+}
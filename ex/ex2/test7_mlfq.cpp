@@ -0,0 +1,74 @@
+/*
+ * test7_mlfq.cpp - An interactive thread that sleeps for a quantum at a time shares the CPU with CPU bound threads,
+ * first under round-robin and then under MLFQ. Under round-robin it waits behind all of them every time it wakes up,
+ * under MLFQ the CPU bound threads sink to the lower levels and it runs right away (but for the periodic resets).
+ *
+ * Output should be the same as test7_mlfq.txt.
+ */
+
+#include <cstdio>
+#include "uthreads.h"
+
+#define BATCH_THREADS 3
+#define PHASE_QUANTA 400
+
+static volatile int phase = 0;
+static int wakeups[3];
+static int waited[3];
+
+void batch()
+{
+    while (true)
+    {
+    }
+}
+
+void interactive()
+{
+    while (true)
+    {
+        int current = phase;
+        int start = uthread_get_total_quantums();
+        uthread_sleep(1);
+        // sleep(1) wakes up 2 quanta after the call, the rest is time spent READY
+        if (phase == current)
+        {
+            wakeups[current]++;
+            waited[current] += uthread_get_total_quantums() - start - 2;
+        }
+    }
+}
+
+static void run_phase()
+{
+    int end = uthread_get_total_quantums() + PHASE_QUANTA;
+    while (uthread_get_total_quantums() < end)
+    {
+    }
+}
+
+int main()
+{
+    uthread_init(1000);
+    for (int i = 0; i < BATCH_THREADS; i++)
+    {
+        uthread_spawn(batch);
+    }
+    int tid = uthread_spawn(interactive);
+
+    printf("priority %d returns %d\n", PRIORITY_LEVELS, uthread_set_priority(tid, PRIORITY_LEVELS));
+
+    run_phase();
+    phase = 1;
+    uthread_set_scheduler(UTHREAD_SCHED_MLFQ);
+    run_phase();
+    phase = 2;
+
+    double round_robin = (double) waited[0] / wakeups[0];
+    double mlfq = (double) waited[1] / wakeups[1];
+    printf("round-robin: waits at least %d quanta after waking up: %s\n", BATCH_THREADS,
+           round_robin >= BATCH_THREADS ? "yes" : "no");
+    printf("mlfq: waits less than a quantum after waking up on average: %s\n", mlfq < 1 ? "yes" : "no");
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,54 @@
+/*
+ * test8_fair.cpp - CPU bound threads with different weights under the fair scheduler get shares of the CPU in
+ * proportion to their weights, counted in the quanta they ran for.
+ *
+ * Output should be the same as test8_fair.txt.
+ */
+
+#include <cstdio>
+#include "uthreads.h"
+
+#define RUN_QUANTA 800
+
+void spin()
+{
+    while (true)
+    {
+    }
+}
+
+void* spin_routine(void* arg)
+{
+    spin();
+    return nullptr;
+}
+
+int main()
+{
+    uthread_init(1000);
+    uthread_set_scheduler(UTHREAD_SCHED_FAIR);
+
+    uthread_attr attr;
+    uthread_attr_init(&attr);
+    attr.weight = 0;
+    printf("spawn with weight 0 returns %d\n", uthread_spawn_ex(spin_routine, nullptr, &attr));
+
+    int light = uthread_spawn(spin);
+    int heavy = uthread_spawn(spin);
+    uthread_set_weight(heavy, 3 * DEFAULT_WEIGHT);
+    uthread_set_weight(0, DEFAULT_WEIGHT / 2);
+
+    int end = uthread_get_total_quantums() + RUN_QUANTA;
+    while (uthread_get_total_quantums() < end)
+    {
+    }
+
+    double heavy_share = (double) uthread_get_quantums(heavy) / uthread_get_quantums(light);
+    double main_share = (double) uthread_get_quantums(0) / uthread_get_quantums(light);
+    printf("heavy thread ran about 3 times as much as the light one: %s\n",
+           heavy_share > 2.5 && heavy_share < 3.5 ? "yes" : "no");
+    printf("main thread ran about half as much as the light one: %s\n",
+           main_share > 0.35 && main_share < 0.65 ? "yes" : "no");
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * test9_sync.cpp - Mutexes, condition variables, semaphores and channels. Threads that yield inside a critical section
+ * still never lose an update, threads wait on a condition until the main thread opens a gate, and a producer sends
+ * numbers through a small channel (and through one without a buffer) to a consumer that checks their order. The main
+ * thread waits for the others on a semaphore.
+ *
+ * Output should be the same as test9_sync.txt.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include "uthreads.h"
+
+#define WORKERS 4
+#define INCREMENTS 1000
+#define MESSAGES 100
+
+static uthread_sem done;
+
+static uthread_mutex counter_mutex;
+static int counter = 0;
+
+static uthread_mutex gate_mutex;
+static uthread_cond gate_cond;
+static bool gate_open = false;
+static int passed = 0;
+
+static uthread_channel channel;
+
+void* increment(void* arg)
+{
+    for (int i = 0; i < INCREMENTS; i++)
+    {
+        uthread_mutex_lock(&counter_mutex);
+        int value = counter;
+        // Every other thread gets to run here, and has to wait for the mutex
+        uthread_yield();
+        counter = value + 1;
+        uthread_mutex_unlock(&counter_mutex);
+    }
+    uthread_sem_post(&done);
+    return nullptr;
+}
+
+void* wait_for_gate(void* arg)
+{
+    uthread_mutex_lock(&gate_mutex);
+    while (!gate_open)
+    {
+        uthread_cond_wait(&gate_cond, &gate_mutex);
+    }
+    passed++;
+    uthread_mutex_unlock(&gate_mutex);
+    uthread_sem_post(&done);
+    return nullptr;
+}
+
+void* produce(void* arg)
+{
+    for (intptr_t i = 1; i <= MESSAGES; i++)
+    {
+        uthread_channel_send(&channel, (void*) i);
+    }
+    uthread_channel_close(&channel);
+    return nullptr;
+}
+
+static void consume(size_t capacity)
+{
+    uthread_channel_init(&channel, capacity);
+    uthread_spawn_ex(produce, nullptr, nullptr);
+    intptr_t expected = 1;
+    bool in_order = true;
+    void* value;
+    while (uthread_channel_receive(&channel, &value) == 0)
+    {
+        in_order = in_order && (intptr_t) value == expected;
+        expected++;
+    }
+    printf("channel of %zu: received %ld values in order: %s\n", capacity, (long) expected - 1,
+           in_order ? "yes" : "no");
+    printf("send on the closed channel returns %d\n", uthread_channel_send(&channel, nullptr));
+    uthread_channel_destroy(&channel);
+}
+
+int main()
+{
+    uthread_init(100000);
+    uthread_sem_init(&done, 0);
+
+    uthread_mutex_init(&counter_mutex);
+    for (int i = 0; i < WORKERS; i++)
+    {
+        uthread_spawn_ex(increment, nullptr, nullptr);
+    }
+    for (int i = 0; i < WORKERS; i++)
+    {
+        uthread_sem_wait(&done);
+    }
+    printf("counter: %d\n", counter);
+    printf("unlock of a mutex this thread does not hold returns %d\n", uthread_mutex_unlock(&counter_mutex));
+
+    uthread_mutex_init(&gate_mutex);
+    uthread_cond_init(&gate_cond);
+    for (int i = 0; i < WORKERS; i++)
+    {
+        uthread_spawn_ex(wait_for_gate, nullptr, nullptr);
+    }
+    // Every thread gets to wait on the gate before it opens
+    uthread_yield();
+    uthread_mutex_lock(&gate_mutex);
+    printf("passed before the gate opened: %d\n", passed);
+    gate_open = true;
+    uthread_cond_broadcast(&gate_cond);
+    printf("lock of a mutex this thread holds returns %d\n", uthread_mutex_lock(&gate_mutex));
+    uthread_mutex_unlock(&gate_mutex);
+    for (int i = 0; i < WORKERS; i++)
+    {
+        uthread_sem_wait(&done);
+    }
+    printf("passed after the gate opened: %d\n", passed);
+
+    consume(4);
+    consume(0);
+
+    uthread_terminate(0);
+    return 0;
+}
@@ -4,63 +4,37 @@
 #include <cassert>
 
 #include "uthreads.h"
-
-#ifdef __x86_64__
-typedef unsigned long address_t;
-#define JB_SP 6
-#define JB_PC 7
-
-address_t translate_address(address_t addr) {
-    address_t ret;
-    asm volatile("xor    %%fs:0x30,%0\n"
-                 "rol    $0x11,%0\n"
-                 : "=g" (ret)
-                 : "0" (addr));
-    return ret;
-}
-#else
-typedef unsigned int address_t;
-#define JB_SP 4
-#define JB_PC 5
-
-address_t translate_address(address_t addr) {
-    address_t ret;
-    asm volatile("xor    %%gs:0x18,%0\n"
-                 "rol    $0x9,%0\n"
-                 : "=g" (ret)
-                 : "0" (addr));
-    return ret;
-}
-#endif
-
-Thread::Thread(int tid, ThreadState state, thread_entry_point entry)
-    : id(tid), state(state), entry(entry), stack(nullptr)
+#include "wait_queue.h"
+
+Thread::Thread(int tid, ThreadState state, thread_entry_point entry, const Stack& stack)
+    : id(tid), state(state), entry(entry), start_routine(nullptr), arg(nullptr), result(nullptr), joinable(false),
+      exited(false), specific{}, priority(0), level(0), level_epoch(0),
+      weight(DEFAULT_WEIGHT), vruntime(0), heap_index(0), fair_sequence(0), rt_period(0), rt_budget(0),
+      rt_relative_deadline(0), rt_period_start(0), rt_deadline(0), rt_budget_left(0), rt_index(0), rt_sequence(0),
+      rt_throttled(false), affinity(-1), stack(stack),
+      run_next(nullptr), run_prev(nullptr), run_queue(nullptr), wake_quantum(0), wheel_next(nullptr),
+      wheel_pprev(nullptr), cond_mutex(nullptr), carrier(nullptr), on_cpu(false), in_deque(false)
 {
     total_quantums = 0;
+    stats = ThreadStats{};
+    wait_queue_init(&joiners);
 
-    if (tid != 0) {
+    if (stack.base != nullptr) {
         // Regular (spawned) thread
-        stack = new char[STACK_SIZE];
-        address_t sp = (address_t)stack + STACK_SIZE - sizeof(address_t);
-        address_t pc = (address_t)entry;
-        sigsetjmp(context, 1);
-
-        // Set stack pointer and program counter manually
-        context->__jmpbuf[JB_SP] = translate_address(sp);
-        context->__jmpbuf[JB_PC] = translate_address(pc);
-        sigemptyset(&context->__saved_mask);  // Also reset signal mask
+        // The first switch to this thread starts thread_start(this) at the top of its stack
+        context_init(&context, stack.base, stack.size, &thread_start, this);
+        // thread_start enables preemption once the switch to it is done
+        preempt_disabled = 1;
+    } else {
+        // The main thread keeps running on the process stack, its context is saved by the first switch away from it
+        context.sp = nullptr;
+        preempt_disabled = 0;
     }
     is_blocked = false;
 }
 
 
 
-Thread::~Thread() {
-    if (stack != nullptr) {
-        delete[] stack;
-    }
-}
-
 void Thread::increase_quantums() {
     total_quantums++;
 }
@@ -1,28 +1,108 @@
 #ifndef THREAD_H
 #define THREAD_H
 
+#include <atomic>
 #include <csignal>
-#include <csetjmp>
+#include <cstdint>
 #include <memory>
 
-enum class ThreadState { RUNNING, READY, BLOCKED };
+#include "context_switch.h"
+#include "stack_pool.h"
+#include "tracer.h"
+#include "uthreads.h"
+#include "waiter.h"
 
-typedef void (*thread_entry_point)();
+class RunQueue;
+struct Carrier;
 
-class Thread {
+// TERMINATED is only seen in M:N mode, for a thread terminated while it was running on another carrier or waiting in
+// a deque; whichever carrier meets it next destroys it
+enum class ThreadState { RUNNING, READY, BLOCKED, TERMINATED };
+
+// The Waiter part holds the thread's links and state while it waits on a wait queue, in the deadline heap or for an fd
+class Thread : public Waiter {
 public:
     int id;
     ThreadState state;
+    // a thread runs either entry() or start_routine(arg)
     thread_entry_point entry;
-    char* stack;
-    sigjmp_buf context;
+    uthread_start_routine start_routine;
+    void* arg;
+    // what start_routine returned, whether the thread is kept once it ends until uthread_join collects that, whether
+    // it ended (its stack is released then) and the thread waiting to join it
+    void* result;
+    bool joinable;
+    bool exited;
+    uthread_wait_queue joiners;
+    // the thread's values of the thread-specific data keys
+    void* specific[UTHREAD_KEYS_MAX];
+    // the MLFQ level the thread was given, and the level it is at now (valid while level_epoch is the MLFQ's)
+    int priority;
+    int level;
+    uint64_t level_epoch;
+    // the share of the CPU under the fair policy, the virtual runtime it is ordered by, its position in the policy's
+    // heap and when it was queued there
+    int weight;
+    uint64_t vruntime;
+    size_t heap_index;
+    uint64_t fair_sequence;
+    // the real-time class: the period, budget and relative deadline in quanta (rt_period is 0 for a regular thread),
+    // the quantum the current period started at, its absolute deadline and the budget left in it, and the thread's
+    // position in the heap of the real-time policy it is in (the throttled one if rt_throttled is set)
+    int rt_period;
+    int rt_budget;
+    int rt_relative_deadline;
+    uint64_t rt_period_start;
+    uint64_t rt_deadline;
+    int rt_budget_left;
+    size_t rt_index;
+    uint64_t rt_sequence;
+    bool rt_throttled;
+    int affinity;
+    Stack stack;
+    thread_context context;
     int total_quantums;
+    bool is_blocked;
+
+    // links of the run queue the thread is in (run_queue is nullptr if it is in none)
+    Thread* run_next;
+    Thread* run_prev;
+    RunQueue* run_queue;
+
+    // the quantum a sleeping thread wakes up at, and its links in the sleep wheel (wheel_pprev is nullptr if it is
+    // not sleeping)
+    uint64_t wake_quantum;
+    Thread* wheel_next;
+    Thread** wheel_pprev;
+
+    // the mutex a thread parked on a condition variable takes back when it is signalled
+    uthread_mutex* cond_mutex;
 
-    Thread(int tid, ThreadState state, thread_entry_point entry = nullptr);
-    ~Thread();
+    // the thread's scheduling statistics, while tracing
+    ThreadStats stats;
+
+    // set while the thread changes scheduler state; a tick that comes in meanwhile is deferred (a thread that is not
+    // running always has it set, since it switched away inside the scheduler)
+    volatile sig_atomic_t preempt_disabled;
+
+    // the carrier the thread is running on (nullptr if it is not running), whether its context is still in use there
+    // (it is until the next context on that carrier is running), and whether it waits in a carrier's deque or inbox
+    Carrier* carrier;
+    std::atomic<bool> on_cpu;
+    bool in_deque;
+
+    // stack is taken from the stack pool by the caller, which also gives it back (the main thread has none)
+    Thread(int tid, ThreadState state, thread_entry_point entry = nullptr, const Stack& stack = Stack{nullptr, 0, 0});
     void increase_quantums();
     int get_quantums() const;
 
 };
 
-#endif // THREAD_Hgbc
\ No newline at end of file
+/**
+ * @brief The first function every spawned thread runs, on its own stack. Defined by the thread library.
+ *
+ * arg is the Thread being started.
+*/
+void thread_start(void* arg);
+
+#endif // THREAD_H
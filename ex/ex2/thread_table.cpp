@@ -0,0 +1,125 @@
+#include "thread_table.h"
+
+#include <new>
+
+#define BITS_PER_WORD 64
+
+ThreadTable::ThreadTable() : first_free_word(0), index_bits(1), count(0), limit(0) {}
+
+ThreadTable::~ThreadTable() {
+    release();
+}
+
+void ThreadTable::init(int capacity) {
+    release();
+    limit = capacity;
+    index_bits = 1;
+    while ((1 << index_bits) < capacity) {
+        index_bits++;
+    }
+    chunks.assign((capacity + THREAD_TABLE_CHUNK_SIZE - 1) / THREAD_TABLE_CHUNK_SIZE, nullptr);
+    used.assign((capacity + BITS_PER_WORD - 1) / BITS_PER_WORD, 0);
+    // The slots past the capacity in the last word are never free
+    if (capacity % BITS_PER_WORD != 0) {
+        used.back() = ~0ULL << (capacity % BITS_PER_WORD);
+    }
+    first_free_word = 0;
+}
+
+int ThreadTable::max_capacity() {
+    return 1 << THREAD_TABLE_MAX_INDEX_BITS;
+}
+
+int ThreadTable::capacity() const {
+    return limit;
+}
+
+int ThreadTable::size() const {
+    return count;
+}
+
+ThreadTable::Slot* ThreadTable::slot(uint32_t index) const {
+    Slot* chunk = chunks[index >> THREAD_TABLE_CHUNK_BITS];
+    return chunk == nullptr ? nullptr : &chunk[index & (THREAD_TABLE_CHUNK_SIZE - 1)];
+}
+
+Thread* ThreadTable::thread_at(uint32_t index) const {
+    return (Thread*) slot(index) -> storage;
+}
+
+uint32_t ThreadTable::index_of(int tid) const {
+    return (uint32_t) tid & ((1U << index_bits) - 1);
+}
+
+Thread* ThreadTable::create(ThreadState state, thread_entry_point entry, const Stack& stack) {
+    while (first_free_word < used.size() && used[first_free_word] == ~0ULL) {
+        first_free_word++;
+    }
+    if (first_free_word == used.size()) {
+        return nullptr;
+    }
+    uint32_t index = first_free_word * BITS_PER_WORD + __builtin_ctzll(~used[first_free_word]);
+
+    Slot*& chunk = chunks[index >> THREAD_TABLE_CHUNK_BITS];
+    if (chunk == nullptr) {
+        chunk = new Slot[THREAD_TABLE_CHUNK_SIZE];
+        for (int i = 0; i < THREAD_TABLE_CHUNK_SIZE; i++) {
+            chunk[i].generation = 0;
+        }
+    }
+    Slot* s = slot(index);
+    // The generation takes the bits of the (non-negative) int above the index
+    uint32_t generation_mask = (1U << (31 - index_bits)) - 1;
+    int tid = (int) (index | ((s -> generation & generation_mask) << index_bits));
+
+    auto* thread = new (s -> storage) Thread(tid, state, entry, stack);
+    used[index / BITS_PER_WORD] |= 1ULL << (index % BITS_PER_WORD);
+    count++;
+    return thread;
+}
+
+Thread* ThreadTable::find(int tid) const {
+    if (tid < 0) {
+        return nullptr;
+    }
+    uint32_t index = index_of(tid);
+    if (index >= (uint32_t) limit || !(used[index / BITS_PER_WORD] & (1ULL << (index % BITS_PER_WORD)))) {
+        return nullptr;
+    }
+    Thread* thread = thread_at(index);
+    return thread -> id == tid ? thread : nullptr;
+}
+
+void ThreadTable::destroy(Thread* thread) {
+    uint32_t index = index_of(thread -> id);
+    thread -> ~Thread();
+    slot(index) -> generation++;
+    used[index / BITS_PER_WORD] &= ~(1ULL << (index % BITS_PER_WORD));
+    if (index / BITS_PER_WORD < first_free_word) {
+        first_free_word = index / BITS_PER_WORD;
+    }
+    count--;
+}
+
+void ThreadTable::clear() {
+    for (size_t word = 0; word < used.size(); word++) {
+        uint64_t bits = used[word];
+        while (bits != 0) {
+            uint32_t index = word * BITS_PER_WORD + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            if (index < (uint32_t) limit) {
+                destroy(thread_at(index));
+            }
+        }
+    }
+}
+
+void ThreadTable::release() {
+    clear();
+    for (Slot* chunk : chunks) {
+        delete[] chunk;
+    }
+    chunks.clear();
+    used.clear();
+    limit = 0;
+}
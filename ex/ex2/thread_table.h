@@ -0,0 +1,71 @@
+#ifndef THREAD_TABLE_H
+#define THREAD_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "thread.h"
+
+#define THREAD_TABLE_CHUNK_BITS 8
+#define THREAD_TABLE_CHUNK_SIZE (1 << THREAD_TABLE_CHUNK_BITS)   /* threads per chunk */
+#define THREAD_TABLE_MAX_INDEX_BITS 24                          /* leaves at least 7 bits of generation in a tid */
+
+/*
+ * Owns every Thread, stored in place in a slab indexed by the low bits of the tid.
+ *
+ * The slab is split into chunks of THREAD_TABLE_CHUNK_SIZE threads that are allocated the first time one of their
+ * slots is used and never move, so Thread pointers stay valid and memory grows with the number of threads actually
+ * alive at once rather than with the limit. The bits of a tid above the slot index hold the generation of the slot,
+ * which is bumped every time a thread in it is destroyed: a tid of a terminated thread is not found again even after
+ * its slot is reused, until the generation wraps around. The first thread in every slot has generation 0, so a new
+ * table hands out tids 0, 1, 2... like before.
+ *
+ * A new thread gets the lowest free slot, found through a bitmap of used slots and a hint of the first word that
+ * may have a free bit, so spawning and destroying are O(1) amortized.
+ */
+class ThreadTable {
+public:
+    ThreadTable();
+    ~ThreadTable();
+
+    /* Makes room for up to capacity threads, destroying any existing ones. capacity must be between 1 and
+     * max_capacity(). */
+    void init(int capacity);
+
+    static int max_capacity();
+    int capacity() const;
+    int size() const;
+
+    /* Constructs a thread in the lowest free slot. Returns nullptr if the table is full. Throws std::bad_alloc. */
+    Thread* create(ThreadState state, thread_entry_point entry, const Stack& stack = Stack{nullptr, 0, 0});
+
+    /* The thread whose tid is tid, or nullptr if there is none (including a tid of a destroyed thread). */
+    Thread* find(int tid) const;
+
+    /* Destroys thread and frees its slot. */
+    void destroy(Thread* thread);
+
+    /* Destroys all threads. */
+    void clear();
+
+private:
+    struct Slot {
+        alignas(Thread) unsigned char storage[sizeof(Thread)];
+        uint32_t generation;
+    };
+
+    Slot* slot(uint32_t index) const;
+    Thread* thread_at(uint32_t index) const;
+    uint32_t index_of(int tid) const;
+    void release();
+
+    std::vector<Slot*> chunks;
+    std::vector<uint64_t> used;     // one bit per slot
+    size_t first_free_word;         // no word before it has a free bit
+    int index_bits;
+    int count;
+    int limit;
+};
+
+#endif // THREAD_TABLE_H
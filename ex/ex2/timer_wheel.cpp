@@ -0,0 +1,195 @@
+#include "timer_wheel.h"
+#include "thread.h"
+
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_RANGE(level) ((uint64_t) 1 << (WHEEL_LEVEL_BITS * ((level) + 1)))
+
+TimerWheel::TimerWheel() : slots(), current(0), count(0) {}
+
+uint64_t TimerWheel::now() const {
+    return current;
+}
+
+bool TimerWheel::empty() const {
+    return count == 0;
+}
+
+uint64_t TimerWheel::next_expiry() const {
+    uint64_t cascade_at = (current | WHEEL_MASK) + 1;
+    for (uint64_t quantum = current + 1; quantum < cascade_at; quantum++) {
+        if (slots[0][quantum & WHEEL_MASK] != nullptr) {
+            return quantum;
+        }
+    }
+    // Level 0 also holds deadlines past the cascade, which are no earlier than it
+    return cascade_at;
+}
+
+bool TimerWheel::contains(const Thread* thread) {
+    return thread -> wheel_pprev != nullptr;
+}
+
+void TimerWheel::insert(Thread* thread, uint64_t deadline) {
+    thread -> wake_quantum = deadline;
+    link(thread);
+    count++;
+}
+
+/*
+ * Files a thread by the distance of its deadline from the current quantum. A deadline beyond the top level is
+ * filed at the farthest slot of the top level and re-filed from there when that slot is cascaded.
+ */
+void TimerWheel::link(Thread* thread) {
+    uint64_t deadline = thread -> wake_quantum;
+    uint64_t delta = deadline - current;
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= WHEEL_RANGE(level)) {
+        level++;
+    }
+    if (delta >= WHEEL_RANGE(WHEEL_LEVELS - 1)) {
+        deadline = current + WHEEL_RANGE(WHEEL_LEVELS - 1) - 1;
+    }
+    Thread** head = &slots[level][(deadline >> (WHEEL_LEVEL_BITS * level)) & WHEEL_MASK];
+
+    thread -> wheel_next = *head;
+    if (*head != nullptr) {
+        (*head) -> wheel_pprev = &thread -> wheel_next;
+    }
+    *head = thread;
+    thread -> wheel_pprev = head;
+}
+
+void TimerWheel::remove(Thread* thread) {
+    if (!contains(thread)) {
+        return;
+    }
+    *thread -> wheel_pprev = thread -> wheel_next;
+    if (thread -> wheel_next != nullptr) {
+        thread -> wheel_next -> wheel_pprev = thread -> wheel_pprev;
+    }
+    thread -> wheel_next = nullptr;
+    thread -> wheel_pprev = nullptr;
+    count--;
+}
+
+/*
+ * Moves every thread of a slot to the levels below, by their distance from the current quantum.
+ */
+void TimerWheel::cascade(int level, uint64_t slot) {
+    Thread* thread = slots[level][slot];
+    slots[level][slot] = nullptr;
+    while (thread != nullptr) {
+        Thread* next = thread -> wheel_next;
+        thread -> wheel_next = nullptr;
+        thread -> wheel_pprev = nullptr;
+        link(thread);
+        thread = next;
+    }
+}
+
+/*
+ * Sorts a list of threads linked through wheel_next by deadline, keeping the order of equal ones (a merge sort, so a
+ * catch-up over many expired threads stays O(n log n) without allocating).
+ */
+static Thread* sort_by_deadline(Thread* list) {
+    if (list == nullptr || list -> wheel_next == nullptr) {
+        return list;
+    }
+    Thread* slow = list;
+    Thread* fast = list -> wheel_next;
+    while (fast -> wheel_next != nullptr && fast -> wheel_next -> wheel_next != nullptr) {
+        slow = slow -> wheel_next;
+        fast = fast -> wheel_next -> wheel_next;
+    }
+    Thread* second = sort_by_deadline(slow -> wheel_next);
+    slow -> wheel_next = nullptr;
+    Thread* first = sort_by_deadline(list);
+
+    Thread* merged = nullptr;
+    Thread** tail = &merged;
+    while (first != nullptr && second != nullptr) {
+        Thread** smaller = second -> wake_quantum < first -> wake_quantum ? &second : &first;
+        *tail = *smaller;
+        tail = &(*smaller) -> wheel_next;
+        *smaller = (*smaller) -> wheel_next;
+    }
+    *tail = first != nullptr ? first : second;
+    return merged;
+}
+
+/*
+ * Moves the wheel straight to quantum in a single cascade of every thread in it: the threads whose deadline it reaches
+ * expire in deadline order, and the others are filed again by their distance from quantum. Costs O(slots + threads)
+ * however far quantum is, where stepping there costs a slot per quantum.
+ */
+void TimerWheel::jump(uint64_t quantum, wheel_expire_fn expire) {
+    Thread* all = nullptr;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < WHEEL_SLOTS; slot++) {
+            Thread* thread = slots[level][slot];
+            slots[level][slot] = nullptr;
+            while (thread != nullptr) {
+                Thread* next = thread -> wheel_next;
+                thread -> wheel_pprev = nullptr;
+                thread -> wheel_next = all;
+                all = thread;
+                thread = next;
+            }
+        }
+    }
+
+    current = quantum;
+    Thread* expired = nullptr;
+    while (all != nullptr) {
+        Thread* thread = all;
+        all = thread -> wheel_next;
+        thread -> wheel_next = nullptr;
+        if (thread -> wake_quantum <= quantum) {
+            thread -> wheel_next = expired;
+            expired = thread;
+            count--;
+        } else {
+            link(thread);
+        }
+    }
+
+    expired = sort_by_deadline(expired);
+    while (expired != nullptr) {
+        Thread* thread = expired;
+        expired = thread -> wheel_next;
+        thread -> wheel_next = nullptr;
+        expire(thread);
+    }
+}
+
+void TimerWheel::advance(uint64_t quantum, wheel_expire_fn expire) {
+    if (quantum <= current) {
+        return;
+    }
+    if (count == 0) {
+        // Nothing to expire or cascade on the way, as after the ticks were stopped for a while
+        current = quantum;
+        return;
+    }
+    if (quantum - current > WHEEL_SLOTS) {
+        jump(quantum, expire);
+        return;
+    }
+    while (current < quantum) {
+        current++;
+        // When a level wraps around, the slot of the level above that now falls in its range is spread below
+        for (int level = 1; level < WHEEL_LEVELS; level++) {
+            if ((current & (WHEEL_RANGE(level - 1) - 1)) != 0) {
+                break;
+            }
+            cascade(level, (current >> (WHEEL_LEVEL_BITS * level)) & WHEEL_MASK);
+        }
+
+        Thread** head = &slots[0][current & WHEEL_MASK];
+        while (*head != nullptr) {
+            Thread* thread = *head;
+            remove(thread);
+            expire(thread);
+        }
+    }
+}
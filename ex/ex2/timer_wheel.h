@@ -0,0 +1,62 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstdint>
+
+class Thread;
+
+#define WHEEL_LEVEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_LEVEL_BITS)   /* slots per level */
+#define WHEEL_LEVELS 4                        /* covers deadlines up to 2^24 quanta ahead, later ones are re-filed */
+
+typedef void (*wheel_expire_fn)(Thread* thread);
+
+/*
+ * A hierarchical timing wheel of sleeping threads, keyed by the absolute quantum number they wake up at.
+ *
+ * Level 0 has one slot per quantum for the next WHEEL_SLOTS quanta, and every further level covers WHEEL_SLOTS times
+ * the range of the one below it. When the lower levels wrap around, the matching slot of the level above is cascaded
+ * down. Advancing by one quantum costs O(1) plus the expired threads (cascades are amortized over the quanta they
+ * span), independent of the number of sleeping threads. Threads are linked through Thread::wheel_next/wheel_pprev,
+ * so nothing is ever allocated.
+ */
+class TimerWheel {
+public:
+    TimerWheel();
+
+    /* The last quantum the wheel was advanced to. */
+    uint64_t now() const;
+
+    /* Files thread to expire when the wheel reaches deadline, which must be after now(). */
+    void insert(Thread* thread, uint64_t deadline);
+
+    /* Removes thread from the wheel, if it is in it. */
+    void remove(Thread* thread);
+
+    /* Whether no thread is in the wheel. */
+    bool empty() const;
+
+    /* A quantum after now() that is no later than the earliest deadline in the wheel, which must not be empty: the
+     * first deadline on level 0, or the next cascade if that comes first, since it may bring earlier ones down. */
+    uint64_t next_expiry() const;
+
+    /* Whether thread is in the wheel. */
+    static bool contains(const Thread* thread);
+
+    /* Advances the wheel up to quantum, calling expire for each thread whose deadline it reaches, in deadline order.
+     * expire is called after the thread is removed from the wheel. The wheel steps one quantum at a time, but jumps
+     * when it is empty or quantum is more than a level 0 revolution away (after the ticks were stopped), so the cost
+     * is bounded however many quanta went by. */
+    void advance(uint64_t quantum, wheel_expire_fn expire);
+
+private:
+    void link(Thread* thread);
+    void cascade(int level, uint64_t slot);
+    void jump(uint64_t quantum, wheel_expire_fn expire);
+
+    Thread* slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    uint64_t current;
+    int count;
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,163 @@
+#include "tracer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <unordered_set>
+
+#define NANOS_PER_SECOND 1000000000ULL
+#define CALIBRATION_NSECS 2000000 /* how long the TSC is compared with CLOCK_MONOTONIC for */
+
+static uint64_t monotonic_nsecs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NANOS_PER_SECOND + now.tv_nsec;
+}
+
+static const char* const event_names[] = {"switch", "preempted", "wakeup", "blocked", "sleep"};
+
+Tracer::Tracer() : active(false), mask(0), next(0), session(0), session_start(0), nsecs_per_tick(0) {}
+
+void Tracer::calibrate() {
+    if (nsecs_per_tick != 0) {
+        return;
+    }
+    uint64_t tsc = now();
+    uint64_t nsecs = monotonic_nsecs();
+    struct timespec pause = {0, CALIBRATION_NSECS};
+    nanosleep(&pause, nullptr);
+    nsecs_per_tick = (double) (monotonic_nsecs() - nsecs) / (double) (now() - tsc);
+}
+
+void Tracer::start(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    if (size != mask + 1 || records == nullptr) {
+        records.reset(new Record[size]);
+        mask = size - 1;
+    }
+    for (size_t i = 0; i <= mask; i++) {
+        records[i].sequence.store(0, std::memory_order_relaxed);
+    }
+    next.store(0, std::memory_order_relaxed);
+    session++;
+    session_start = now();
+    active.store(true, std::memory_order_release);
+}
+
+void Tracer::stop() {
+    active.store(false, std::memory_order_release);
+}
+
+void Tracer::record(TraceEventType type, int tid, int other, int carrier, uint64_t when) {
+    uint64_t index = next.fetch_add(1, std::memory_order_relaxed);
+    Record* record = &records[index & mask];
+    record -> sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    record -> tsc = when;
+    record -> type = type;
+    record -> tid = tid;
+    record -> other = other;
+    record -> carrier = carrier;
+    record -> sequence.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::touch(ThreadStats* stats) const {
+    if (stats -> session != session) {
+        memset(stats, 0, sizeof(*stats));
+        stats -> session = session;
+    }
+}
+
+void Tracer::mark_ready(ThreadStats* stats, uint64_t when) {
+    touch(stats);
+    stats -> ready_since = when;
+}
+
+void Tracer::start_running(ThreadStats* stats, uint64_t when) {
+    touch(stats);
+    if (stats -> ready_since != 0 && when > stats -> ready_since) {
+        uint64_t waited = when - stats -> ready_since;
+        stats -> wait_ticks += waited;
+        uint64_t nsecs = (uint64_t) ((double) waited * nsecs_per_tick);
+        int bucket = nsecs < 2 ? 0 : 63 - __builtin_clzll(nsecs);
+        stats -> latency_histogram[bucket < UTHREAD_LATENCY_BUCKETS ? bucket : UTHREAD_LATENCY_BUCKETS - 1]++;
+    }
+    stats -> ready_since = 0;
+    stats -> running_since = when;
+    stats -> runs++;
+}
+
+void Tracer::stop_running(ThreadStats* stats, uint64_t when) {
+    touch(stats);
+    if (stats -> running_since != 0 && when > stats -> running_since) {
+        stats -> run_ticks += when - stats -> running_since;
+    }
+    stats -> running_since = 0;
+}
+
+void Tracer::fill(const ThreadStats* stats, uthread_stats* out) const {
+    memset(out, 0, sizeof(*out));
+    if (stats -> session != session || session == 0) {
+        return;
+    }
+    uint64_t run_ticks = stats -> run_ticks;
+    if (enabled() && stats -> running_since != 0) {
+        run_ticks += now() - stats -> running_since;
+    }
+    out -> run_nsecs = (uint64_t) ((double) run_ticks * nsecs_per_tick);
+    out -> wait_nsecs = (uint64_t) ((double) stats -> wait_ticks * nsecs_per_tick);
+    out -> runs = stats -> runs;
+    memcpy(out -> latency_histogram, stats -> latency_histogram, sizeof(out -> latency_histogram));
+}
+
+double Tracer::to_usecs(uint64_t tsc) const {
+    return tsc > session_start ? (double) (tsc - session_start) * nsecs_per_tick / 1000 : 0;
+}
+
+/*
+ * Every uthread gets a track of its own (its tid), with a slice for every run and an instant for every other event.
+ * A run whose start was overwritten in the ring is left out, and runs still going on are closed at the last event.
+ */
+bool Tracer::export_json(const char* path) const {
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+    fprintf(file, "{\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"uthreads\"}}");
+
+    uint64_t end = next.load(std::memory_order_acquire);
+    uint64_t first = end > mask + 1 ? end - (mask + 1) : 0;
+    std::unordered_set<int> running;
+    double last = 0;
+    for (uint64_t index = first; index < end; index++) {
+        const Record* record = &records[index & mask];
+        if (record -> sequence.load(std::memory_order_acquire) != index + 1) {
+            continue;
+        }
+        double ts = to_usecs(record -> tsc);
+        last = ts;
+        if (record -> type != TraceEventType::SWITCH) {
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"sched\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":0,"
+                          "\"tid\":%d,\"args\":{\"by\":%d,\"carrier\":%d}}",
+                    event_names[(int) record -> type], ts, record -> tid, record -> other, record -> carrier);
+            continue;
+        }
+        // A switch from other to tid (-1 is the carrier's idle loop)
+        if (record -> other >= 0 && running.erase(record -> other) > 0) {
+            fprintf(file, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":0,\"tid\":%d}", ts, record -> other);
+        }
+        if (record -> tid >= 0 && running.insert(record -> tid).second) {
+            fprintf(file, ",\n{\"name\":\"running\",\"cat\":\"sched\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":0,\"tid\":%d,"
+                          "\"args\":{\"carrier\":%d}}", ts, record -> tid, record -> carrier);
+        }
+    }
+    for (int tid : running) {
+        fprintf(file, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":0,\"tid\":%d}", last, tid);
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    return fclose(file) == 0;
+}
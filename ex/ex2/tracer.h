@@ -0,0 +1,98 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <x86intrin.h>
+
+#include "uthreads.h"
+
+enum class TraceEventType : uint32_t { SWITCH, PREEMPT, WAKEUP, BLOCK, SLEEP };
+
+/*
+ * The scheduling statistics of a thread, kept while tracing. They belong to the tracing session they were last
+ * touched in, and start over in a new one. Times are in TSC ticks; a thread that is not READY (or not RUNNING) has
+ * ready_since (or running_since) 0.
+ */
+struct ThreadStats {
+    uint64_t session;
+    uint64_t ready_since;
+    uint64_t running_since;
+    uint64_t run_ticks;
+    uint64_t wait_ticks;
+    uint64_t runs;
+    uint64_t latency_histogram[UTHREAD_LATENCY_BUCKETS];
+};
+
+/*
+ * Records scheduler events in a ring buffer, with TSC timestamps, and keeps the per-thread statistics.
+ *
+ * Recording is lock-free: a writer claims the next slot with a fetch_add on the write index and publishes it with the
+ * slot's sequence number, so carriers never wait for each other, and the oldest events are overwritten once the ring
+ * is full. Everything is skipped with a single relaxed load while no session is active. The ring is read (by
+ * export_json) only once the session is stopped.
+ */
+class Tracer {
+public:
+    Tracer();
+
+    /* Measures the TSC frequency against CLOCK_MONOTONIC, sleeping for a couple of milliseconds the first time it is
+     * called. Must be called before the first start. */
+    void calibrate();
+
+    /* Starts a new session with room for at least capacity events. Throws bad_alloc. */
+    void start(size_t capacity);
+    void stop();
+
+    bool enabled() const {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    static uint64_t now() {
+        return __rdtsc();
+    }
+
+    void record(TraceEventType type, int tid, int other, int carrier, uint64_t when);
+
+    /* The thread of stats became READY at when. */
+    void mark_ready(ThreadStats* stats, uint64_t when);
+
+    /* The thread of stats started running at when: the time it waited is counted in its wait time and histogram. */
+    void start_running(ThreadStats* stats, uint64_t when);
+
+    /* The thread of stats stopped running at when. */
+    void stop_running(ThreadStats* stats, uint64_t when);
+
+    /* Converts stats to nanoseconds, counting a run still in progress up to now. */
+    void fill(const ThreadStats* stats, uthread_stats* out) const;
+
+    /* Writes the events in the ring to path as Chrome trace-event JSON. Returns false if path cannot be written. */
+    bool export_json(const char* path) const;
+
+private:
+    struct Record {
+        std::atomic<uint64_t> sequence;     // the event's index + 1 once it is written, 0 while it is being written
+        uint64_t tsc;
+        TraceEventType type;
+        int tid;
+        int other;
+        int carrier;
+    };
+
+    /* Resets stats if they belong to an earlier session. */
+    void touch(ThreadStats* stats) const;
+    double to_usecs(uint64_t tsc) const;
+
+    std::atomic<bool> active;
+    std::unique_ptr<Record[]> records;
+    size_t mask;
+    std::atomic<uint64_t> next;
+
+    uint64_t session;
+    uint64_t session_start;
+    double nsecs_per_tick;
+};
+
+#endif // TRACER_H
@@ -2,17 +2,40 @@
 #include <sys/time.h>
 
 #include <unistd.h>
+#include <cerrno>
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
-#include <csetjmp>
+#include <ctime>
 #include <string>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
 #include "uthreads.h"
+#include "preempt.h"
 #include "thread.h"
-
+#include "run_queue.h"
+#include "timer_wheel.h"
+#include "thread_table.h"
+#include "stack_pool.h"
+#include "carrier.h"
+#include "round_robin_policy.h"
+#include "mlfq_policy.h"
+#include "fair_policy.h"
+#include "realtime_policy.h"
+#include "wait_queue.h"
+#include "reactor.h"
+#include "deadline_heap.h"
+#include "tracer.h"
+#include "coroutine.h"
+
+#include <atomic>
 #include <cassert>
 #include <iostream>
-#include <queue>
-#include <unordered_map>
 
 
 #define SYSTEM_ERROR_MSG "system error: "
@@ -20,49 +43,184 @@
 #define SYSTEM_ERROR_IND 0
 #define LIBRARY_ERROR_IND 1
 #define SECOND 1000000
+#define NANOS_PER_USEC 1000
 
-#define TIMER_ON sigprocmask(SIG_UNBLOCK, &timer_sigset, NULL);
-#define TIMER_OFF sigprocmask(SIG_BLOCK, &timer_sigset, NULL);
+#define IDLE_STACK_SIZE 16384
+#define IDLE_WAIT_NSECS 1000000 /* a carrier idle in epoll looks for other carriers' work at least this often */
+#define NANOS_PER_MSEC 1000000
+#define NANOS_PER_SECOND 1000000000ULL
+#define SPINS_BEFORE_YIELD 128
+#define IO_EVENTS_PER_POLL 64
+#define COROUTINE_STACK_SIZE (256 * 1024) /* the stack the coroutines run on, reserved lazily */
 
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
 
 
 
 
+// the one-shot timer interval of every MLFQ level (a quantum, doubled per level); round-robin and the carriers of
+// M:N mode only use the first
+static struct itimerspec timers[PRIORITY_LEVELS];
 
-static struct itimerval timer;
+// every thread, indexed by tid
+static ThreadTable thread_table;
 
-// a Thread pointer to delete from
-static Thread* pending_delete = nullptr;
+// the stacks of the spawned threads
+static StackPool stack_pool;
 
-// ID-to-thread mapping
-static std::unordered_map<int, Thread*> thread_map;
+// the scheduling policies, and the one that orders the READY threads when there is a single carrier: the policy chosen
+// with uthread_set_scheduler, or while there are real-time threads the real-time class, which passes the other threads
+// on to it
+static RoundRobinPolicy round_robin_policy;
+static MlfqPolicy mlfq_policy;
+static FairPolicy fair_policy;
+static RealtimePolicy realtime_policy(&round_robin_policy);
+static SchedulerPolicy* policy = &round_robin_policy;
 
-// Ready queue for Round-Robin
-static std::queue<int> ready_queue;
+// sleeping threads, by the quantum they wake up at
+static TimerWheel sleep_wheel;
 
-// Min-heap of free thread IDs
-static std::priority_queue<int, std::vector<int>, std::greater<int>> free_tids;
+// threads sleeping until a CLOCK_MONOTONIC deadline, and the timer that goes off at the earliest one
+static DeadlineHeap deadline_sleepers;
+static timer_t deadline_timer;
 
-// map for sleeping threads
+// threads waiting for a file descriptor to be ready
+static Reactor reactor;
 
-static std::unordered_map<int, int> sleeping_map;
+// scheduler events and per-thread statistics, while a tracing session is on
+static Tracer tracer;
 
-// queue for awakening threads from sleep
+// the coroutines ready to be resumed, and the coroutine runner, parked on coroutine_runner_queue while there are none
+static uthread_wait_queue ready_coroutines;
+static uthread_wait_queue coroutine_runner_queue;
+static bool coroutine_runner_spawned = false;
 
-static std::queue<int> wake_queue;
+// the destructors of the thread-specific data keys, of which key_count were created (written under the scheduler lock,
+// and key_count last, so a key below it can be used without the lock)
+static uthread_key_destructor key_destructors[UTHREAD_KEYS_MAX];
+static std::atomic<int> key_count(0);
 
-int running_tid;
-static int total_quantums;
+static uint64_t total_quantums;
 
-// signal set for timer
-sigset_t timer_sigset;
+// With a single carrier, the ticks stop while the running thread has nothing to share the CPU with and no sleeper or
+// I/O waiter needs the quanta counted. The quanta it runs for meanwhile are counted from the process' CPU time, since
+// the last quantum that was counted.
+static bool ticks_stopped = false;
+static uint64_t ticks_stopped_at;
 
+// the kernel threads running uthreads
+static Carrier* carriers = nullptr;
+static int carrier_count = 1;
 
-void free_resources() {
-    for (auto it : thread_map) {
-        delete it.second;
+// With more than one carrier, everything above (and the scheduling state of every Thread) is guarded by this lock
+static std::atomic_flag scheduler_lock = ATOMIC_FLAG_INIT;
+
+// Bumped whenever a thread is made READY, so idle carriers can sleep on it with a futex
+static std::atomic<uint32_t> work_sequence(0);
+static std::atomic<int> idle_carriers(0);
+
+// While every carrier is idle no timer ticks, so the quanta are counted in real time instead: from the quantum the
+// last carrier went idle at, and when
+static uint64_t quantum_nsecs;
+static uint64_t all_idle_quantum;
+static uint64_t all_idle_since;
+
+// the carrier of this kernel thread and the uthread running on it (nullptr while the carrier is idle)
+static thread_local Carrier* this_carrier = nullptr;
+static thread_local Thread* this_thread = nullptr;
+
+void timer_tick();
+void arm_timer(int level);
+void restart_ticks();
+void set_carrier_timer(const struct itimerspec* interval);
+uint64_t count_stopped_quanta();
+void expire_deadlines();
+void unpark(Waiter* waiter);
+void make_coroutine_ready(Waiter* waiter);
+void leave_for_queue(Thread* self);
+void run_key_destructors(Thread* thread);
+
+/*
+ * A uthread can continue on another carrier after any switch, while the compiler assumes the address of a
+ * thread_local variable never changes within a function. These are never inlined or analysed, so every call reads
+ * the variables of the kernel thread it actually runs on.
+ */
+__attribute__((noipa)) Carrier* current_carrier() {
+    return this_carrier;
+}
+
+__attribute__((noipa)) Thread* current_thread() {
+    return this_thread;
+}
+
+/*
+ * Preemption is disabled per uthread rather than per carrier: a thread is never preempted while its flag is set, so
+ * it cannot move to another carrier in the middle of setting or clearing it.
+ */
+void preempt_disable() {
+    current_thread() -> preempt_disabled = 1;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+void preempt_enable() {
+    Thread* self = current_thread();
+    while (true) {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        self -> preempt_disabled = 0;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        if (!current_carrier() -> preempt_pending) {
+            return;
+        }
+        // A tick came in while preemption was disabled. Disable again before looking, since a signal arriving right
+        // now runs the tick by itself and clears preempt_pending.
+        self -> preempt_disabled = 1;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        Carrier* carrier = current_carrier();
+        if (carrier -> preempt_pending) {
+            carrier -> preempt_pending = 0;
+            timer_tick();
+        }
+    }
+}
+
+/*
+ * One round of busy waiting for another carrier. The holder may be a kernel thread that was preempted, with more
+ * carriers than CPUs, so the CPU is given up after a while.
+ */
+void spin_wait(int* spins) {
+    if (++*spins < SPINS_BEFORE_YIELD) {
+        __builtin_ia32_pause();
+    } else {
+        *spins = 0;
+        sched_yield();
+    }
+}
+
+/*
+ * Guards the scheduler state when there is more than one carrier. Only taken with preemption disabled (or on an idle
+ * carrier), so the holder is never switched out.
+ */
+void sched_lock() {
+    if (carrier_count > 1) {
+        int spins = 0;
+        while (scheduler_lock.test_and_set(std::memory_order_acquire)) {
+            spin_wait(&spins);
+        }
+    }
+}
+
+void sched_unlock() {
+    if (carrier_count > 1) {
+        scheduler_lock.clear(std::memory_order_release);
     }
-    thread_map.clear();
+}
+
+
+void free_resources() {
+    // The stacks stay mapped until the process exits, since this may run on one of them
+    thread_table.clear();
 }
 
 /*
@@ -78,299 +236,2202 @@ void error_handler(std::string msg, int error_type) {
     std::cerr << LIBRARY_ERROR_MSG << msg << std::endl;
 }
 
-void move_to_next() {
-  	//save current state of running thread
-    if (sigsetjmp(thread_map[running_tid]->context, 1)==0){
-        TIMER_OFF
-        if (pending_delete!=nullptr) {
-            delete[] thread_map[running_tid] -> stack;
-            thread_map[running_tid] -> stack = nullptr;
-            pending_delete = nullptr;
+/*
+ * Makes the scheduler call the real-time class only while there are real-time threads, and the regular policy
+ * directly otherwise.
+ */
+void select_policy() {
+    policy = realtime_policy.size() > 0 ? &realtime_policy : realtime_policy.regular();
+}
+
+/*
+ * Gives back the stack of a thread that is not running and destroys it.
+ */
+void destroy_thread(Thread* thread) {
+    if (thread -> rt_period != 0) {
+        realtime_policy.leave(thread);
+        select_policy();
+    }
+    stack_pool.release(thread -> stack);
+    if (thread -> joinable) {
+        // Kept, with its result, until it is joined or detached
+        thread -> stack = Stack{nullptr, 0, 0};
+        thread -> exited = true;
+        if (!wait_queue_empty(&thread -> joiners)) {
+            unpark(wait_queue_pop(&thread -> joiners));
         }
-        TIMER_ON
-        Thread* next_thread = thread_map[ready_queue.front()];
-        ready_queue.pop();
-        next_thread -> state = ThreadState::RUNNING;
-        running_tid = next_thread -> id;
-        thread_map[running_tid] -> increase_quantums();
-        siglongjmp(next_thread -> context, 1);
+        return;
     }
+    thread_table.destroy(thread);
+}
 
+uint64_t monotonic_nsecs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NANOS_PER_SECOND + now.tv_nsec;
+}
 
+uint64_t process_cpu_nsecs() {
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec * NANOS_PER_SECOND + now.tv_nsec;
 }
 
-void reset_timer() {
-    if (setitimer(ITIMER_VIRTUAL, &timer, nullptr))
-    {
-        error_handler("problem setting timer", SYSTEM_ERROR_IND);
-        free_resources();
-        exit(1);
+/*
+ * Wakes carriers that sleep for lack of work: one of them, or all of them for work only one carrier may take.
+ */
+void notify_idle(bool all) {
+    work_sequence.fetch_add(1, std::memory_order_release);
+    if (idle_carriers.load(std::memory_order_acquire) > 0) {
+        syscall(SYS_futex, &work_sequence, FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, nullptr, nullptr, 0);
     }
-    total_quantums++;
 }
 
-void timer_handler(int sig) {
-    TIMER_OFF
-    // Step 1: Wake sleeping threads whose timers expired
-    std::vector<int> expired;
-    for (auto& pair : sleeping_map) {
-        int tid = pair.first;
-        if (--sleeping_map[tid] == 0) {
-            expired.push_back(tid);
-        }
+/*
+ * The tracing hooks, called with the scheduler lock held. While tracing is off each costs a single load.
+ * trace_switch records that the carrier switched from prev to next, either of which is nullptr for its idle loop.
+ */
+void trace_switch(Thread* prev, Thread* next) {
+    if (!tracer.enabled()) {
+        return;
     }
-    for (int tid : expired) {
-        sleeping_map.erase(tid);
-        if (!thread_map[tid]->is_blocked) {
-            wake_queue.push(tid);
-        }
+    uint64_t now = Tracer::now();
+    if (prev != nullptr) {
+        tracer.stop_running(&prev -> stats, now);
     }
-
-    // Step 2: Move waking threads to READY state
-    while (!wake_queue.empty()) {
-        int tid = wake_queue.front();
-        wake_queue.pop();
-        Thread* thread = thread_map[tid];
-        thread->state = ThreadState::READY;
-        ready_queue.push(tid);
+    if (next != nullptr) {
+        tracer.start_running(&next -> stats, now);
     }
+    tracer.record(TraceEventType::SWITCH, next != nullptr ? next -> id : -1, prev != nullptr ? prev -> id : -1,
+                  current_carrier() -> index, now);
+}
 
-    // Step 3: Context switch if needed
-    if (!ready_queue.empty()) {
-        // Switch to next thread
-        thread_map[running_tid] -> state = ThreadState::READY;
-        ready_queue.push(running_tid);
-        TIMER_ON
-        move_to_next();
-    } else {
-        thread_map[running_tid] -> increase_quantums();
+/*
+ * Records an event that happened to thread, caused by the running thread.
+ */
+void trace_event(TraceEventType type, Thread* thread) {
+    if (!tracer.enabled()) {
+        return;
     }
-    total_quantums++;
-    TIMER_ON
+    Thread* current = current_thread();
+    tracer.record(type, thread -> id, current != nullptr ? current -> id : -1, current_carrier() -> index,
+                  Tracer::now());
 }
 
-
-
-
-
-void timer_init(int quantum_usecs) {
-    struct sigaction sa = {0};
-    sigemptyset(&timer_sigset);
-    sigaddset(&timer_sigset, SIGVTALRM);
-
-
-    // Install timer_handler as the signal handler for SIGVTALRM.
-    sa.sa_handler = &timer_handler;
-    if (sigaction(SIGVTALRM, &sa, nullptr) < 0)
-    {
-        error_handler("sigaction failed", SYSTEM_ERROR_IND);
-        free_resources();
-        exit(1);
+/*
+ * Makes a thread READY. With several carriers it goes to the deque of the current carrier, unless it is still in one
+ * (a thread blocked while it was queued is only dropped when a carrier takes it).
+ */
+void make_ready(Thread* thread) {
+    thread -> state = ThreadState::READY;
+    if (tracer.enabled()) {
+        tracer.mark_ready(&thread -> stats, Tracer::now());
+    }
+    if (carrier_count == 1) {
+        policy -> enqueue(thread);
+        if (ticks_stopped) {
+            restart_ticks();
+        }
+        return;
+    }
+    if (!thread -> in_deque) {
+        thread -> in_deque = true;
+        current_carrier() -> deque.push(thread);
+        notify_idle(false);
     }
-
-    // Configure the timer to expire after 1 sec... */
-    timer.it_value.tv_sec = quantum_usecs / SECOND;        // first time interval, seconds part
-    timer.it_value.tv_usec = quantum_usecs % SECOND;        // first time interval, microseconds part
-
-    // configure the timer to expire every 3 sec after that.
-    timer.it_interval.tv_sec = quantum_usecs / SECOND;    // following time intervals, seconds part
-    timer.it_interval.tv_usec = quantum_usecs % SECOND;    // following time intervals, microseconds part
-
-    reset_timer();
-
-
 }
 
-int get_tid() {
-    int tid=-1;
-    if (!free_tids.empty()) {
-        tid = free_tids.top();
-        free_tids.pop();
-    } else if (thread_map.size() < MAX_THREAD_NUM) {
-        tid = thread_map.size(); // or keep a running counter
+/*
+ * Makes a thread that was spawned, resumed or woken up READY.
+ */
+void wake(Thread* thread) {
+    if (carrier_count == 1) {
+        policy -> on_wake(thread);
+    }
+    trace_event(TraceEventType::WAKEUP, thread);
+    make_ready(thread);
+    if (thread -> rt_period != 0 && carrier_count == 1 && realtime_policy.preempts(current_thread(), thread)) {
+        // A real-time thread does not wait for the next tick: the running thread is preempted as soon as it enables
+        // preemption again
+        current_carrier() -> preempt_pending = 1;
     }
-    return tid;
 }
 
-int uthread_init(int quantum_usecs) {
-    if (quantum_usecs <= 0) {
-        error_handler("quantum_usecs must be positive", SYSTEM_ERROR_IND);
-        return -1;
+/*
+ * Takes a thread out of the ready queue, if it is in it. With several carriers the thread is left in its deque and
+ * dropped when it is taken, since a deque only gives up its top.
+ */
+void remove_ready(Thread* thread) {
+    if (carrier_count == 1) {
+        policy -> dequeue(thread);
     }
+}
 
-
-    auto* main_thread = new Thread(get_tid(), ThreadState::RUNNING, nullptr);
-    thread_map[main_thread->id] = main_thread;
-    running_tid = main_thread->id;
-    main_thread -> increase_quantums();
-    // Now save the real environment of the main thread
-    if (sigsetjmp(main_thread->context, 1) != 0) {
-        // If we return here from siglongjmp, just return
-        return 0;
+/*
+ * Claims a thread just taken from a deque or an inbox: returns it if it is still READY. A thread that was blocked
+ * while it waited is dropped, and a terminated one is destroyed.
+ */
+Thread* claim(Thread* thread) {
+    thread -> in_deque = false;
+    if (thread -> state == ThreadState::READY) {
+        return thread;
     }
-
-    timer_init(quantum_usecs);
-
-    return 0;
+    if (thread -> state == ThreadState::TERMINATED) {
+        destroy_thread(thread);
+    }
+    return nullptr;
 }
 
+/*
+ * Removes and returns the next thread to run on the current carrier, or nullptr if there is none. With several
+ * carriers: the carrier's own inbox and deque first, then the deques of the other carriers, starting from the next.
+ */
+Thread* take_ready() {
+    if (carrier_count == 1) {
+        return policy -> empty() ? nullptr : policy -> pick_next();
+    }
+    Carrier* carrier = current_carrier();
+    while (!carrier -> inbox.empty()) {
+        Thread* thread = claim(carrier -> inbox.pop_front());
+        if (thread != nullptr) {
+            return thread;
+        }
+    }
+    for (int i = 0; i < carrier_count; i++) {
+        Carrier* victim = &carriers[(carrier -> index + i) % carrier_count];
+        Thread* thread;
+        while ((thread = victim -> deque.take()) != nullptr) {
+            if (claim(thread) != nullptr) {
+                return thread;
+            }
+        }
+    }
+    return nullptr;
+}
 
-
-
-int uthread_spawn(thread_entry_point entry_point) {
-    Thread* thread = nullptr;
-    if (entry_point == nullptr) {
-        error_handler("entry_point is null", LIBRARY_ERROR_IND);
-        return -1;
+/*
+ * Whether take_ready may find a thread. With several carriers it may still find none, since the deques hold threads
+ * that were blocked or terminated while they waited.
+ */
+bool has_ready() {
+    if (carrier_count == 1) {
+        return !policy -> empty();
     }
-    if (thread_map.size() == MAX_THREAD_NUM) {
-        error_handler("thread_map is full", LIBRARY_ERROR_IND);
-        return -1;
+    for (int i = 0; i < carrier_count; i++) {
+        if (!carriers[i].deque.empty() || !carriers[i].inbox.empty()) {
+            return true;
+        }
     }
-    try {
-        TIMER_OFF
+    return false;
+}
 
-        thread = new Thread(get_tid(), ThreadState::READY, entry_point);
-        thread_map[thread -> id] = thread;
-        ready_queue.push(thread -> id);
-        TIMER_ON
+/*
+ * Runs on the context that was just switched to, before anything else. The context switched away from is saved now,
+ * so its thread may run on another carrier, or be destroyed if it terminated itself.
+ */
+void finish_switch() {
+    Carrier* carrier = current_carrier();
+    if (carrier -> prev != nullptr) {
+        carrier -> prev -> on_cpu.store(false, std::memory_order_release);
+        carrier -> prev = nullptr;
+    }
+    if (carrier -> pending_delete != nullptr) {
+        Thread* thread = carrier -> pending_delete;
+        carrier -> pending_delete = nullptr;
+        sched_lock();
+        destroy_thread(thread);
+        sched_unlock();
+    }
+}
 
-        return thread->id;
-    } catch (const std::exception& e) {
-        error_handler(e.what(), SYSTEM_ERROR_IND);
-        return -1;
+/*
+ * Waits until no carrier runs on the context of thread any more, and claims it for the current one.
+ */
+void take_cpu(Thread* thread) {
+    int spins = 0;
+    while (thread -> on_cpu.load(std::memory_order_acquire)) {
+        spin_wait(&spins);
     }
+    thread -> on_cpu.store(true, std::memory_order_relaxed);
 }
 
-void remove_from_ready_queue(int tid_to_remove) {
-    std::queue<int> temp;
-    while (!ready_queue.empty()) {
-        int tid = ready_queue.front();
-        ready_queue.pop();
-        if (tid != tid_to_remove) {
-            temp.push(tid);
+/*
+ * Switches from current to next on the current carrier.
+ * Must be called with preemption disabled and the scheduler lock held, which is released before the switch. The timer
+ * signal is never masked, so the switch needs no sigprocmask. The resumed thread enables preemption again.
+ */
+void switch_to(Thread* current, Thread* next) {
+    Carrier* carrier = current_carrier();
+    if (carrier_count == 1) {
+        policy -> on_run(next);
+        if (!policy -> fixed_quantum()) {
+            arm_timer(policy -> slice_shift(next));
         }
     }
-    ready_queue = std::move(temp);
+    trace_switch(current, next);
+    next -> state = ThreadState::RUNNING;
+    next -> increase_quantums();
+    current -> carrier = nullptr;
+    next -> carrier = carrier;
+    carrier -> prev = current;
+    this_thread = next;
+    sched_unlock();
+    take_cpu(next);
+    context_switch(&current -> context, &next -> context);
+    finish_switch();
 }
 
-
-bool tid_exists(int tid) {
-    if (thread_map.find(tid) == thread_map.end()) {
-        error_handler("tid not found", LIBRARY_ERROR_IND);
-        return false;
+/*
+ * Gives up the CPU, for good or until current is made READY again: switches to the next READY thread, or to the
+ * carrier's idle context if there is none. Called like switch_to.
+ */
+void leave_cpu(Thread* current) {
+    Thread* next = take_ready();
+    if (next == current) {
+        // Made READY again on its way out, by what the new quantum woke up (a coroutine sleeper waking the coroutine
+        // runner, an fd a thread waits for turning out ready): it keeps the CPU
+        trace_switch(current, current);
+        current -> state = ThreadState::RUNNING;
+        if (carrier_count == 1) {
+            policy -> on_run(current);
+        }
+        current -> increase_quantums();
+        sched_unlock();
+        return;
     }
-    return true;
+    if (next != nullptr) {
+        switch_to(current, next);
+        return;
+    }
+    trace_switch(current, nullptr);
+    Carrier* carrier = current_carrier();
+    current -> carrier = nullptr;
+    carrier -> prev = current;
+    this_thread = nullptr;
+    sched_unlock();
+    context_switch(&current -> context, &carrier -> idle_context);
+    finish_switch();
 }
 
+void thread_start(void* arg) {
+    auto* thread = (Thread*) arg;
+    finish_switch();
+    preempt_enable();
+    if (thread -> start_routine != nullptr) {
+        thread -> result = thread -> start_routine(thread -> arg);
+    } else {
+        thread -> entry();
+    }
+    // Returning from the entry point terminates the thread instead of running off the end of its stack
+    uthread_terminate(thread -> id);
+}
 
+/*
+ * Destroys the thread-specific data of thread, the running thread, which is ending. Called without the scheduler lock,
+ * since the destructors may call the library.
+ */
+void run_key_destructors(Thread* thread) {
+    for (int round = 0; round < UTHREAD_DESTRUCTOR_ITERATIONS; round++) {
+        bool called = false;
+        int keys = key_count.load(std::memory_order_acquire);
+        for (int key = 0; key < keys; key++) {
+            void* value = thread -> specific[key];
+            if (value != nullptr && key_destructors[key] != nullptr) {
+                thread -> specific[key] = nullptr;
+                key_destructors[key](value);
+                called = true;
+            }
+        }
+        if (!called) {
+            return;
+        }
+    }
+}
 
+/*
+ * Called from the sleep wheel for a thread whose sleep is over.
+ */
+void wake_sleeper(Thread* thread) {
+    if (!thread->is_blocked) {
+        wake(thread);
+    }
+}
 
-int uthread_terminate(int tid) {
-    TIMER_OFF
-    if (!tid_exists(tid)) {
-        return -1;
+/*
+ * Makes the threads whose file descriptors became ready READY, waiting up to timeout_msecs for one to. Called with the
+ * scheduler lock held when timeout_msecs is 0, and without it otherwise.
+ */
+void poll_io(int timeout_msecs) {
+    struct epoll_event events[IO_EVENTS_PER_POLL];
+    int count = reactor.wait(events, IO_EVENTS_PER_POLL, timeout_msecs);
+    if (count <= 0) {
+        return;
     }
-    if (tid==0) {
-        free_resources();
-        exit(0);
+    if (timeout_msecs != 0) {
+        sched_lock();
     }
-    Thread* thread = thread_map[tid];
-    if (thread->state == ThreadState::READY) {
-        remove_from_ready_queue(thread->id);
+    reactor.dispatch(events, count, &unpark);
+    if (timeout_msecs != 0) {
+        sched_unlock();
     }
+}
 
-
-    sleeping_map.erase(tid);
-    free_tids.push(tid);
-
-    if (thread_map[tid] -> state == ThreadState::RUNNING) {
-        TIMER_ON
-        pending_delete = thread_map[tid];
-        reset_timer();
-        move_to_next();
-
-    }else{
-	    delete[] thread_map[tid] -> stack;
-        thread_map[tid] -> stack = nullptr;
+/*
+ * Sets the deadline timer to the earliest deadline in the deadline heap, which must not be empty.
+ */
+void arm_deadline_timer() {
+    uint64_t deadline = deadline_sleepers.next_deadline();
+    struct itimerspec when = {};
+    when.it_value.tv_sec = (time_t) (deadline / NANOS_PER_SECOND);
+    when.it_value.tv_nsec = (long) (deadline % NANOS_PER_SECOND);
+    if (timer_settime(deadline_timer, TIMER_ABSTIME, &when, nullptr) < 0) {
+        error_handler("problem setting timer", SYSTEM_ERROR_IND);
     }
+}
 
-    TIMER_ON
-    return 0;
+/*
+ * Wakes the threads whose uthread_sleep_ns deadline has passed, and sets the deadline timer to the next deadline.
+ */
+void expire_deadlines() {
+    uint64_t now = monotonic_nsecs();
+    if (deadline_sleepers.next_deadline() > now) {
+        return;
+    }
+    deadline_sleepers.expire(now, &unpark);
+    if (!deadline_sleepers.empty()) {
+        arm_deadline_timer();
+    }
 }
 
-int uthread_block(int tid) {
-    TIMER_OFF
-    if (!tid_exists(tid)) {
-        return -1;
+/*
+ * Counts the quanta the running thread ran for since the ticks stopped, as the ticks would have, and returns how far
+ * into the current one it is.
+ */
+uint64_t count_stopped_quanta() {
+    uint64_t ran = process_cpu_nsecs() - ticks_stopped_at;
+    uint64_t quanta = ran / quantum_nsecs;
+    ticks_stopped_at += quanta * quantum_nsecs;
+    Thread* current = current_thread();
+    for (uint64_t i = 0; i < quanta; i++) {
+        total_quantums++;
+        policy -> on_quantum(total_quantums);
+        current -> increase_quantums();
     }
-    if (tid == 0) {
-        error_handler("cannot block main thread", LIBRARY_ERROR_IND);
-        return -1;
+    return ran - quanta * quantum_nsecs;
+}
+
+/*
+ * Counts the start of a new quantum, whatever its reason, and wakes the threads that sleep until it. Runs before the
+ * next thread is picked, so the woken threads (and those whose file descriptors became ready) are already in the ready
+ * queue. The MLFQ puts every thread back at its priority once every MLFQ_RESET_QUANTA quanta, so the threads on the
+ * lower levels never starve, and the real-time threads whose period starts get their budget back. The quanta the
+ * running thread ran for alone, while the ticks were stopped, are counted first.
+ */
+void start_quantum() {
+    if (ticks_stopped) {
+        count_stopped_quanta();
+        ticks_stopped = false;
     }
-    if (thread_map[tid] -> state == ThreadState::READY) {
-        remove_from_ready_queue(tid);
+    total_quantums++;
+    policy -> on_quantum(total_quantums);
+    if (reactor.armed()) {
+        poll_io(0);
     }
-    thread_map[tid] -> state = ThreadState::BLOCKED;
-    thread_map[tid] -> is_blocked = true;
-    if (running_tid == tid) {
-        TIMER_ON
-        reset_timer();
-        move_to_next();
+    sleep_wheel.advance(total_quantums, &wake_sleeper);
+    if (!deadline_sleepers.empty()) {
+        expire_deadlines();
     }
-    TIMER_ON
-    return 0;
 }
 
-int uthread_resume(int tid) {
-    TIMER_OFF
+/*
+ * Starts a fresh timer interval, the one of the given MLFQ level, on the current carrier. A tick still pending from the
+ * old one is dropped.
+ */
+void arm_timer(int level) {
+    set_carrier_timer(&timers[carrier_count == 1 ? level : 0]);
+}
 
-    if (!tid_exists(tid)) {
-        return -1;
-    }
-    if (thread_map[tid] -> is_blocked == true) {
-        thread_map[tid] -> is_blocked = false;
-        if (sleeping_map.find(tid) == sleeping_map.end()) {
-            thread_map[tid] -> state = ThreadState::READY;
-            ready_queue.push(tid);
+/*
+ * Sets the preemption timer of the current carrier to go off once, after interval. A single carrier uses
+ * ITIMER_VIRTUAL, which is much cheaper to set on every switch than a POSIX CPU-time timer.
+ */
+void set_carrier_timer(const struct itimerspec* interval) {
+    Carrier* carrier = current_carrier();
+    int result;
+    if (carrier_count == 1) {
+        struct itimerval value = {};
+        value.it_value.tv_sec = interval -> it_value.tv_sec;
+        value.it_value.tv_usec = interval -> it_value.tv_nsec / NANOS_PER_USEC;
+        if (value.it_value.tv_sec == 0 && value.it_value.tv_usec == 0) {
+            // A zero value would disarm the timer
+            value.it_value.tv_usec = 1;
         }
+        result = setitimer(ITIMER_VIRTUAL, &value, nullptr);
+    } else {
+        result = timer_settime(carrier -> timer, 0, interval, nullptr);
+    }
+    if (result < 0)
+    {
+        error_handler("problem setting timer", SYSTEM_ERROR_IND);
+        free_resources();
+        exit(1);
     }
-    TIMER_ON
+    carrier -> preempt_pending = 0;
+}
 
-    return 0;
+/*
+ * Starts the ticks again once another thread is made READY, for what is left of the running thread's quantum.
+ */
+void restart_ticks() {
+    uint64_t into = count_stopped_quanta();
+    ticks_stopped = false;
+    uint64_t left = quantum_nsecs - into;
+    struct itimerspec rest = {};
+    rest.it_value.tv_sec = (time_t) (left / NANOS_PER_SECOND);
+    rest.it_value.tv_nsec = (long) (left % NANOS_PER_SECOND);
+    set_carrier_timer(&rest);
 }
 
-int uthread_sleep(int num_quantums) {
-    TIMER_OFF
-    if (running_tid == 0) {
-        error_handler("can't block main thread", LIBRARY_ERROR_IND);
-        return -1;
+/*
+ * Starts the next timer interval of current, which keeps running after a tick. On a single carrier a thread that is
+ * alone, with no sleeper and no I/O waiter needing the quanta counted, gets none: the ticks stop until another thread
+ * is made READY or current leaves the CPU.
+ */
+void continue_timer(Thread* current) {
+    if (carrier_count > 1) {
+        arm_timer(0);
+        return;
     }
-    sleeping_map[running_tid] = num_quantums;
-    thread_map[running_tid] -> state = ThreadState::BLOCKED;
-    TIMER_ON
-    reset_timer();
-    move_to_next();
-    return 0;
+    if (!has_ready() && sleep_wheel.empty() && !reactor.armed()) {
+        ticks_stopped = true;
+        ticks_stopped_at = process_cpu_nsecs();
+        return;
+    }
+    arm_timer(policy -> fixed_quantum() ? 0 : policy -> slice_shift(current));
 }
 
-int uthread_get_tid() {
-    return running_tid;
+void reset_timer() {
+    arm_timer(0);
+    start_quantum();
 }
 
+/*
+ * Gives up the CPU from a public call, which runs with preemption disabled and the scheduler lock held. The next
+ * thread gets a fresh timer interval (under MLFQ, switch_to gives it the interval of its level). Returns, with
+ * preemption still disabled but without the lock, when current runs again.
+ */
+void switch_from_call(Thread* current) {
+    if (policy -> fixed_quantum()) {
+        reset_timer();
+    } else {
+        start_quantum();
+    }
+    leave_cpu(current);
+}
 
-int uthread_get_total_quantums() {
-    return total_quantums;
+/*
+ * Called by a thread that blocks or sleeps itself, before its quantum is over.
+ */
+void blocked_early(Thread* current) {
+    if (carrier_count == 1) {
+        policy -> on_block(current);
+    }
+}
 
+/*
+ * Called with the scheduler lock held by a running thread that another carrier blocked or terminated, which leaves
+ * the CPU now. Returns (without the lock) when it is resumed.
+ */
+void stop_current(Thread* current) {
+    if (current -> state == ThreadState::TERMINATED) {
+        current_carrier() -> pending_delete = current;
+    }
+    leave_cpu(current);
 }
 
-int uthread_get_quantums(int tid) {
-    if (!tid_exists(tid)) {
-        return -1;
+/*
+ * Parks the running thread on queue until unpark makes it READY again. Called like switch_from_call, and returns like
+ * it.
+ */
+void park(uthread_wait_queue* queue) {
+    Thread* self = current_thread();
+    if (self -> state == ThreadState::TERMINATED) {
+        stop_current(self);
     }
-    return thread_map[tid]->get_quantums();
+    wait_queue_push(queue, self);
+    leave_for_queue(self);
 }
 
+/*
+ * Switches away from the running thread, which was just put on a wait queue, until unpark makes it READY again.
+ */
+void leave_for_queue(Thread* self) {
+    self -> state = ThreadState::BLOCKED;
+    trace_event(TraceEventType::BLOCK, self);
+    blocked_early(self);
+    switch_from_call(self);
+}
 
+/*
+ * Ends the wait of a waiter just taken off a wait queue or the deadline heap: a coroutine is queued for the coroutine
+ * runner, and a thread is made READY, unless it was blocked with uthread_block while it waited.
+ */
+void unpark(Waiter* waiter) {
+    if (waiter -> coroutine) {
+        make_coroutine_ready(waiter);
+        return;
+    }
+    auto* thread = static_cast<Thread*>(waiter);
+    if (!thread -> is_blocked) {
+        wake(thread);
+    }
+}
 
+/*
+ * The handler is installed with SA_NODEFER, so SIGVTALRM is never blocked by the kernel and a switch from here leaves
+ * the signal mask as every other switch does. A signal that comes in while preemption is disabled, or while the
+ * carrier is idle, is deferred.
+ */
+void timer_handler(int sig) {
+    int saved_errno = errno;
+    Thread* self = current_thread();
+    if (self == nullptr || self -> preempt_disabled) {
+        current_carrier() -> preempt_pending = 1;
+        errno = saved_errno;
+        return;
+    }
+    preempt_disable();
+    current_carrier() -> preempt_pending = 0;
+    timer_tick();
+    preempt_enable();
+    errno = saved_errno;
+}
+
+/*
+ * Runs once per expired quantum. Nothing here allocates: sleepers are woken from the timer wheel and the threads move
+ * between intrusive queues and preallocated deques.
+ */
+void timer_tick() {
+    sched_lock();
+    Thread* current = current_thread();
+    // Step 1: A new quantum starts, waking the threads that sleep until it
+    start_quantum();
+
+    // The timer is one-shot: whatever runs next gets a fresh interval (under MLFQ, switch_to gives it the interval of
+    // its level)
+    if (current -> state != ThreadState::RUNNING) {
+        arm_timer(0);
+        stop_current(current);
+        return;
+    }
+
+    if (carrier_count == 1) {
+        policy -> tick(current);
+    }
+
+    // Step 2: Context switch if needed
+    if (has_ready()) {
+        // Switch to next thread
+        make_ready(current);
+        Thread* next = take_ready();
+        if (next != current) {
+            trace_event(TraceEventType::PREEMPT, current);
+            arm_timer(0);
+            switch_to(current, next);
+            return;
+        }
+        // With several carriers, all the other threads in the deques turned out to be gone
+        trace_switch(current, current);
+        current -> state = ThreadState::RUNNING;
+    }
+    if (carrier_count == 1) {
+        policy -> on_run(current);
+    }
+    continue_timer(current);
+    current -> increase_quantums();
+    sched_unlock();
+}
+
+/*
+ * Counts the current carrier as idle, with the scheduler lock held. The last carrier to go idle starts counting the
+ * quanta in real time.
+ */
+void enter_idle() {
+    if (idle_carriers.fetch_add(1, std::memory_order_acq_rel) + 1 == carrier_count) {
+        all_idle_quantum = total_quantums;
+        all_idle_since = monotonic_nsecs();
+    }
+}
+
+void leave_idle() {
+    idle_carriers.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+/*
+ * When the next sleeper wakes up (CLOCK_MONOTONIC), or 0 if no idle carrier has to wake up for it: there are no
+ * sleepers, or some carrier still runs threads and its ticks count the quanta and see the deadlines. Called with the
+ * scheduler lock held.
+ */
+uint64_t idle_deadline() {
+    if (idle_carriers.load(std::memory_order_acquire) != carrier_count) {
+        return 0;
+    }
+    uint64_t deadline = 0;
+    if (!sleep_wheel.empty()) {
+        deadline = all_idle_since + (sleep_wheel.next_expiry() - all_idle_quantum) * quantum_nsecs;
+    }
+    if (!deadline_sleepers.empty() && (deadline == 0 || deadline_sleepers.next_deadline() < deadline)) {
+        deadline = deadline_sleepers.next_deadline();
+    }
+    return deadline;
+}
+
+/*
+ * Starts the quanta that passed in real time since every carrier went idle, waking the sleepers whose time has come.
+ * Called with the scheduler lock held.
+ */
+void catch_up_idle_quanta() {
+    if (idle_carriers.load(std::memory_order_acquire) != carrier_count) {
+        return;
+    }
+    uint64_t target = all_idle_quantum + (monotonic_nsecs() - all_idle_since) / quantum_nsecs;
+    if (total_quantums >= target) {
+        return;
+    }
+    // A long idle spell spans many quanta, so the wheel and the reactor are only looked at by the last one
+    while (total_quantums < target - 1) {
+        total_quantums++;
+        policy -> on_quantum(total_quantums);
+    }
+    start_quantum();
+}
+
+/*
+ * Blocks the idle current carrier until a thread may have been made READY (the futex on work_sequence), a file
+ * descriptor became ready, or deadline (0 for none) passed. Nothing runs in between, so an idle process uses no CPU.
+ */
+void idle_sleep(uint32_t sequence, uint64_t deadline) {
+    uint64_t timeout = 0;
+    if (deadline != 0) {
+        uint64_t now = monotonic_nsecs();
+        if (deadline <= now) {
+            return;
+        }
+        timeout = deadline - now;
+    }
+    if (reactor.armed()) {
+        // epoll does not watch the work_sequence futex, so with other carriers making threads READY the wait is short
+        if (carrier_count > 1 && (timeout == 0 || timeout > IDLE_WAIT_NSECS)) {
+            timeout = IDLE_WAIT_NSECS;
+        }
+        poll_io(timeout == 0 ? -1 : (int) ((timeout + NANOS_PER_MSEC - 1) / NANOS_PER_MSEC));
+        return;
+    }
+    struct timespec relative = {(time_t) (timeout / NANOS_PER_SECOND), (long) (timeout % NANOS_PER_SECOND)};
+    syscall(SYS_futex, &work_sequence, FUTEX_WAIT_PRIVATE, sequence, timeout == 0 ? nullptr : &relative, nullptr, 0);
+}
+
+/*
+ * What a carrier runs when it has no thread: looks for a READY thread in its own inbox and deque and in the other
+ * carriers' deques, and sleeps in idle_sleep when there is none. The carrier's ticks are deferred while it is idle.
+ */
+void idle_loop(void* arg) {
+    auto* carrier = (Carrier*) arg;
+    bool idle = false;
+    while (true) {
+        finish_switch();
+        uint32_t sequence = work_sequence.load(std::memory_order_acquire);
+        sched_lock();
+        Thread* next = take_ready();
+        if (next == nullptr) {
+            if (!idle) {
+                enter_idle();
+                idle = true;
+            }
+            uint64_t deadline = idle_deadline();
+            sched_unlock();
+            idle_sleep(sequence, deadline);
+            sched_lock();
+            catch_up_idle_quanta();
+            if (!deadline_sleepers.empty()) {
+                expire_deadlines();
+            }
+            sched_unlock();
+            continue;
+        }
+        if (idle) {
+            leave_idle();
+            idle = false;
+        }
+        start_quantum();
+        trace_switch(nullptr, next);
+        next -> state = ThreadState::RUNNING;
+        next -> increase_quantums();
+        next -> carrier = carrier;
+        this_thread = next;
+        sched_unlock();
+        arm_timer(0);
+        take_cpu(next);
+        context_switch(&carrier -> idle_context, &next -> context);
+    }
+}
+
+/*
+ * Creates a timer on clock that sends SIGVTALRM to the kernel thread tid alone.
+ */
+void create_timer(clockid_t clock, pid_t tid, timer_t* timer) {
+    struct sigevent event = {};
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGVTALRM;
+    event.sigev_notify_thread_id = tid;
+    if (timer_create(clock, &event, timer) < 0)
+    {
+        error_handler("timer_create failed", SYSTEM_ERROR_IND);
+    }
+}
+
+/*
+ * Creates the preemption timer of a carrier. It measures the CPU time of the calling kernel thread, which must be
+ * the carrier's, and signals that thread alone.
+ */
+void create_carrier_timer(Carrier* carrier) {
+    create_timer(CLOCK_THREAD_CPUTIME_ID, carrier -> tid, &carrier -> timer);
+}
+
+/*
+ * The kernel thread of every carrier but the first.
+ */
+void* carrier_main(void* arg) {
+    auto* carrier = (Carrier*) arg;
+    this_carrier = carrier;
+    carrier -> tid = gettid();
+    create_carrier_timer(carrier);
+    arm_timer(0);
+    // The kernel thread's own stack is never switched back to
+    thread_context boot;
+    context_switch(&boot, &carrier -> idle_context);
+    return nullptr;
+}
+
+
+void timer_init(int quantum_usecs) {
+    struct sigaction sa = {0};
+
+    // Install timer_handler as the signal handler for SIGVTALRM.
+    sa.sa_handler = &timer_handler;
+    sa.sa_flags = SA_NODEFER;
+    if (sigaction(SIGVTALRM, &sa, nullptr) < 0)
+    {
+        error_handler("sigaction failed", SYSTEM_ERROR_IND);
+        free_resources();
+        exit(1);
+    }
+
+    // Configure the timer to expire once, after a quantum (twice as long on every MLFQ level below the first). Every
+    // tick arms it again, if anything needs the next one
+    for (int level = 0; level < PRIORITY_LEVELS; level++) {
+        long long usecs = (long long) quantum_usecs << level;
+        timers[level].it_value.tv_sec = usecs / SECOND;                         // seconds part
+        timers[level].it_value.tv_nsec = (usecs % SECOND) * NANOS_PER_USEC;     // nanoseconds part
+    }
+
+    // With several carriers, ITIMER_VIRTUAL would count the CPU time of all of them and signal any one, so every
+    // carrier gets a timer on its own CPU time instead
+    if (carrier_count > 1) {
+        create_carrier_timer(current_carrier());
+    }
+    create_timer(CLOCK_MONOTONIC, current_carrier() -> tid, &deadline_timer);
+
+    reset_timer();
+
+
+}
+
+int uthread_init(int quantum_usecs, int max_threads, int carrier_threads) {
+    if (quantum_usecs <= 0) {
+        error_handler("quantum_usecs must be positive", SYSTEM_ERROR_IND);
+        return -1;
+    }
+    if (max_threads <= 0 || max_threads > ThreadTable::max_capacity()) {
+        error_handler("max_threads must be between 1 and " + std::to_string(ThreadTable::max_capacity()),
+                      LIBRARY_ERROR_IND);
+        return -1;
+    }
+    if (carrier_threads <= 0 || carrier_threads > MAX_CARRIERS) {
+        error_handler("carrier_threads must be between 1 and " + std::to_string(MAX_CARRIERS), LIBRARY_ERROR_IND);
+        return -1;
+    }
+
+    if (!reactor.init()) {
+        error_handler("epoll_create1 failed", SYSTEM_ERROR_IND);
+    }
+    thread_table.init(max_threads);
+    deadline_sleepers.reserve(max_threads);
+    fair_policy.reserve(max_threads);
+    Thread* main_thread = thread_table.create(ThreadState::RUNNING, nullptr);
+    main_thread -> increase_quantums();
+
+    carrier_count = carrier_threads;
+    carriers = new Carrier[carrier_count];
+    for (int i = 0; i < carrier_count; i++) {
+        Carrier* carrier = &carriers[i];
+        carrier -> index = i;
+        if (carrier_count > 1) {
+            carrier -> deque.init(max_threads);
+        }
+        carrier -> prev = nullptr;
+        carrier -> pending_delete = nullptr;
+        carrier -> idle_stack = stack_pool.acquire(IDLE_STACK_SIZE);
+        context_init(&carrier -> idle_context, carrier -> idle_stack.base, carrier -> idle_stack.size, &idle_loop,
+                     carrier);
+        carrier -> preempt_pending = 0;
+    }
+
+    Carrier* first = &carriers[0];
+    first -> pthread = pthread_self();
+    first -> tid = gettid();
+    this_carrier = first;
+    this_thread = main_thread;
+    main_thread -> carrier = first;
+    main_thread -> on_cpu.store(true, std::memory_order_relaxed);
+
+    // A thread that wakes up may be up to a quantum behind the others under the fair policy
+    quantum_nsecs = (uint64_t) quantum_usecs * NANOS_PER_USEC;
+    fair_policy.set_wake_credit(quantum_nsecs);
+    timer_init(quantum_usecs);
+
+    for (int i = 1; i < carrier_count; i++) {
+        if (pthread_create(&carriers[i].pthread, nullptr, &carrier_main, &carriers[i]) != 0) {
+            error_handler("pthread_create failed", SYSTEM_ERROR_IND);
+        }
+    }
+
+    return 0;
+}
+
+
+
+
+int uthread_spawn(thread_entry_point entry_point) {
+    Thread* thread = nullptr;
+    if (entry_point == nullptr) {
+        error_handler("entry_point is null", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    try {
+        preempt_disable();
+        sched_lock();
+        if (thread_table.size() == thread_table.capacity()) {
+            sched_unlock();
+            preempt_enable();
+            error_handler("too many threads", LIBRARY_ERROR_IND);
+            return -1;
+        }
+
+        thread = thread_table.create(ThreadState::READY, entry_point, stack_pool.acquire(STACK_SIZE));
+        wake(thread);
+        int tid = thread -> id;
+        sched_unlock();
+        preempt_enable();
+
+        return tid;
+    } catch (const std::exception& e) {
+        error_handler(e.what(), SYSTEM_ERROR_IND);
+        return -1;
+    }
+}
+
+int uthread_spawn_many(const thread_entry_point* entries, int n, int* tids_out) {
+    if (n < 1) {
+        error_handler("n must be positive", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        if (entries[i] == nullptr) {
+            error_handler("entry_point is null", LIBRARY_ERROR_IND);
+            return -1;
+        }
+    }
+    try {
+        preempt_disable();
+        sched_lock();
+        if (n > thread_table.capacity() - thread_table.size()) {
+            sched_unlock();
+            preempt_enable();
+            error_handler("too many threads", LIBRARY_ERROR_IND);
+            return -1;
+        }
+
+        for (int i = 0; i < n; i++) {
+            Thread* thread = thread_table.create(ThreadState::READY, entries[i], stack_pool.acquire(STACK_SIZE));
+            wake(thread);
+            if (tids_out != nullptr) {
+                tids_out[i] = thread -> id;
+            }
+        }
+        sched_unlock();
+        preempt_enable();
+
+        return 0;
+    } catch (const std::exception& e) {
+        error_handler(e.what(), SYSTEM_ERROR_IND);
+        return -1;
+    }
+}
+
+void uthread_attr_init(uthread_attr* attr) {
+    attr -> stack_size = STACK_SIZE;
+    attr -> lazy_stack = 1;
+    attr -> priority = 0;
+    attr -> weight = DEFAULT_WEIGHT;
+    attr -> affinity = -1;
+    attr -> joinable = 0;
+}
+
+int uthread_spawn_ex(uthread_start_routine entry, void* arg, const uthread_attr* attr) {
+    uthread_attr defaults;
+    if (attr == nullptr) {
+        uthread_attr_init(&defaults);
+        attr = &defaults;
+    }
+    if (entry == nullptr) {
+        error_handler("entry is null", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    if (attr -> stack_size > MAX_STACK_SIZE) {
+        error_handler("stack_size is too large", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    if (attr -> priority < 0 || attr -> priority >= PRIORITY_LEVELS) {
+        error_handler("priority must be between 0 and " + std::to_string(PRIORITY_LEVELS - 1), LIBRARY_ERROR_IND);
+        return -1;
+    }
+    if (attr -> weight <= 0 || attr -> weight > MAX_WEIGHT) {
+        error_handler("weight must be between 1 and " + std::to_string(MAX_WEIGHT), LIBRARY_ERROR_IND);
+        return -1;
+    }
+    try {
+        preempt_disable();
+        sched_lock();
+        if (thread_table.size() == thread_table.capacity()) {
+            sched_unlock();
+            preempt_enable();
+            error_handler("too many threads", LIBRARY_ERROR_IND);
+            return -1;
+        }
+
+        Stack stack = stack_pool.acquire(attr -> stack_size, attr -> lazy_stack == 0);
+        Thread* thread = thread_table.create(ThreadState::READY, nullptr, stack);
+        thread -> start_routine = entry;
+        thread -> arg = arg;
+        thread -> priority = attr -> priority;
+        thread -> weight = attr -> weight;
+        thread -> joinable = attr -> joinable != 0;
+        mlfq_policy.set_level(thread, attr -> priority);
+        thread -> affinity = attr -> affinity;
+        if (carrier_count > 1 && attr -> affinity >= 0 && attr -> affinity < carrier_count) {
+            // Only the owner pushes to a deque, so the thread waits in the inbox of the carrier it asked for
+            thread -> in_deque = true;
+            carriers[attr -> affinity].inbox.push_back(thread);
+            notify_idle(true);
+        } else {
+            wake(thread);
+        }
+        int tid = thread -> id;
+        sched_unlock();
+        preempt_enable();
+
+        return tid;
+    } catch (const std::exception& e) {
+        error_handler(e.what(), SYSTEM_ERROR_IND);
+        return -1;
+    }
+}
+
+int uthread_spawn_arg(uthread_start_routine entry, void* arg) {
+    uthread_attr attr;
+    uthread_attr_init(&attr);
+    attr.joinable = 1;
+    return uthread_spawn_ex(entry, arg, &attr);
+}
+
+/*
+ * Looks up the thread with ID tid, reporting an error if there is none. Called with the scheduler lock held.
+ */
+Thread* find_thread(int tid) {
+    Thread* thread = thread_table.find(tid);
+    if (thread != nullptr && thread -> state == ThreadState::TERMINATED) {
+        thread = nullptr;
+    }
+    if (thread == nullptr) {
+        error_handler("tid not found", LIBRARY_ERROR_IND);
+    }
+    return thread;
+}
+
+
+
+
+int uthread_terminate(int tid) {
+    Thread* self = current_thread();
+    if (self != nullptr && tid == self -> id && tid != 0) {
+        run_key_destructors(self);
+    }
+    preempt_disable();
+    sched_lock();
+    Thread* thread = find_thread(tid);
+    if (thread == nullptr) {
+        sched_unlock();
+        preempt_enable();
+        return -1;
+    }
+    if (tid==0) {
+        // The lock is kept, so the other carriers stop at their next scheduler call while the process exits
+        free_resources();
+        exit(0);
+    }
+    remove_ready(thread);
+
+
+    sleep_wheel.remove(thread);
+    deadline_sleepers.remove(thread);
+    wait_queue_remove(thread);
+
+    if (thread == current_thread()) {
+        // Still running on its stack, the next context on this carrier deletes it
+        thread -> state = ThreadState::TERMINATED;
+        current_carrier() -> pending_delete = thread;
+        switch_from_call(thread);
+
+    } else if (thread -> carrier != nullptr || thread -> in_deque) {
+        // Running on another carrier, or waiting in a deque: destroyed by the carrier that meets it next
+        thread -> state = ThreadState::TERMINATED;
+        sched_unlock();
+    } else {
+        destroy_thread(thread);
+        sched_unlock();
+    }
+
+    preempt_enable();
+    return 0;
+}
+
+/*
+ * Looks up a joinable thread that may have ended, reporting an error if there is none. Called with the scheduler lock
+ * held.
+ */
+Thread* find_joinable(int tid) {
+    Thread* thread = thread_table.find(tid);
+    if (thread == nullptr || (thread -> state == ThreadState::TERMINATED && !thread -> joinable)) {
+        error_handler("tid not found", LIBRARY_ERROR_IND);
+        return nullptr;
+    }
+    if (!thread -> joinable) {
+        error_handler("thread is not joinable", LIBRARY_ERROR_IND);
+        return nullptr;
+    }
+    if (!wait_queue_empty(&thread -> joiners)) {
+        error_handler("thread is already being joined", LIBRARY_ERROR_IND);
+        return nullptr;
+    }
+    return thread;
+}
+
+int uthread_join(int tid, void** result) {
+    preempt_disable();
+    sched_lock();
+    Thread* self = current_thread();
+    if (tid == self -> id) {
+        sched_unlock();
+        preempt_enable();
+        error_handler("a thread cannot join itself", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    Thread* thread = find_joinable(tid);
+    if (thread == nullptr) {
+        sched_unlock();
+        preempt_enable();
+        return -1;
+    }
+    while (!thread -> exited) {
+        // destroy_thread wakes this thread up once the other one is gone
+        park(&thread -> joiners);
+        sched_lock();
+    }
+    if (result != nullptr) {
+        *result = thread -> result;
+    }
+    thread_table.destroy(thread);
+    sched_unlock();
+    preempt_enable();
+    return 0;
+}
+
+int uthread_detach(int tid) {
+    preempt_disable();
+    sched_lock();
+    Thread* thread = find_joinable(tid);
+    if (thread == nullptr) {
+        sched_unlock();
+        preempt_enable();
+        return -1;
+    }
+    if (thread -> exited) {
+        thread_table.destroy(thread);
+    } else {
+        thread -> joinable = false;
+    }
+    sched_unlock();
+    preempt_enable();
+    return 0;
+}
+
+int uthread_block(int tid) {
+    preempt_disable();
+    sched_lock();
+    Thread* thread = find_thread(tid);
+    if (thread == nullptr) {
+        sched_unlock();
+        preempt_enable();
+        return -1;
+    }
+    if (tid == 0) {
+        sched_unlock();
+        preempt_enable();
+        error_handler("cannot block main thread", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    remove_ready(thread);
+    thread -> state = ThreadState::BLOCKED;
+    thread -> is_blocked = true;
+    trace_event(TraceEventType::BLOCK, thread);
+    if (thread == current_thread()) {
+        blocked_early(thread);
+        switch_from_call(thread);
+    } else {
+        // A thread running on another carrier leaves the CPU at its next tick
+        sched_unlock();
+    }
+    preempt_enable();
+    return 0;
+}
+
+int uthread_resume(int tid) {
+    preempt_disable();
+    sched_lock();
+
+    Thread* thread = find_thread(tid);
+    if (thread == nullptr) {
+        sched_unlock();
+        preempt_enable();
+        return -1;
+    }
+    if (thread -> is_blocked == true) {
+        thread -> is_blocked = false;
+        if (thread -> carrier != nullptr) {
+            // Blocked from another carrier, and resumed before its next tick took it off the CPU
+            thread -> state = ThreadState::RUNNING;
+        } else if (!TimerWheel::contains(thread) && !deadline_sleepers.contains(thread) &&
+                   thread -> wait_queue == nullptr) {
+            wake(thread);
+        }
+    }
+    sched_unlock();
+    preempt_enable();
+
+    return 0;
+}
+
+int uthread_sleep(int num_quantums) {
+    preempt_disable();
+    Thread* self = current_thread();
+    if (self -> id == 0) {
+        preempt_enable();
+        error_handler("can't block main thread", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    if (num_quantums < 0) {
+        preempt_enable();
+        error_handler("num_quantums must not be negative", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    sched_lock();
+    if (self -> state == ThreadState::TERMINATED) {
+        stop_current(self);
+    }
+    // The quantum that starts when this thread switches away is not counted
+    sleep_wheel.insert(self, total_quantums + 1 + num_quantums);
+    self -> state = ThreadState::BLOCKED;
+    trace_event(TraceEventType::SLEEP, self);
+    blocked_early(self);
+    switch_from_call(self);
+    preempt_enable();
+    return 0;
+}
+
+int uthread_sleep_ns(uint64_t deadline_nsecs) {
+    preempt_disable();
+    Thread* self = current_thread();
+    if (self -> id == 0) {
+        preempt_enable();
+        error_handler("can't block main thread", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    sched_lock();
+    if (self -> state == ThreadState::TERMINATED) {
+        stop_current(self);
+    }
+    if (deadline_nsecs <= monotonic_nsecs()) {
+        sched_unlock();
+        preempt_enable();
+        return 0;
+    }
+    deadline_sleepers.insert(self, deadline_nsecs);
+    if (deadline_sleepers.next_deadline() == deadline_nsecs) {
+        arm_deadline_timer();
+    }
+    self -> state = ThreadState::BLOCKED;
+    trace_event(TraceEventType::SLEEP, self);
+    blocked_early(self);
+    switch_from_call(self);
+    preempt_enable();
+    return 0;
+}
+
+int uthread_yield() {
+    preempt_disable();
+    sched_lock();
+    Thread* current = current_thread();
+    if (current -> state != ThreadState::RUNNING) {
+        stop_current(current);
+    } else if (has_ready()) {
+        make_ready(current);
+        // The next thread starts a new quantum but inherits what is left of the timer's current interval
+        start_quantum();
+        Thread* next = take_ready();
+        if (next != current) {
+            switch_to(current, next);
+        } else {
+            trace_switch(current, current);
+            current -> state = ThreadState::RUNNING;
+            if (carrier_count == 1) {
+                policy -> on_run(current);
+            }
+            current -> increase_quantums();
+            sched_unlock();
+        }
+    } else {
+        sched_unlock();
+    }
+    preempt_enable();
+    return 0;
+}
+
+int uthread_set_scheduler(int policy_id) {
+    SchedulerPolicy* chosen;
+    switch (policy_id) {
+        case UTHREAD_SCHED_RR:
+            chosen = &round_robin_policy;
+            break;
+        case UTHREAD_SCHED_MLFQ:
+            chosen = &mlfq_policy;
+            break;
+        case UTHREAD_SCHED_FAIR:
+            chosen = &fair_policy;
+            break;
+        default:
+            error_handler("unknown scheduling policy", LIBRARY_ERROR_IND);
+            return -1;
+    }
+    if (policy_id != UTHREAD_SCHED_RR && carrier_count > 1) {
+        error_handler("only round-robin runs on several carriers", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    preempt_disable();
+    sched_lock();
+    SchedulerPolicy* regular = realtime_policy.regular();
+    if (chosen != regular) {
+        // The READY threads move over in the order the old policy would have run them
+        while (!regular -> empty()) {
+            Thread* thread = regular -> pick_next();
+            chosen -> on_wake(thread);
+            chosen -> enqueue(thread);
+        }
+        realtime_policy.set_regular(chosen);
+        select_policy();
+        Thread* current = current_thread();
+        if (current -> rt_period == 0) {
+            chosen -> on_run(current);
+        }
+    }
+    sched_unlock();
+    preempt_enable();
+    return 0;
+}
+
+int uthread_set_priority(int tid, int priority) {
+    if (priority < 0 || priority >= PRIORITY_LEVELS) {
+        error_handler("priority must be between 0 and " + std::to_string(PRIORITY_LEVELS - 1), LIBRARY_ERROR_IND);
+        return -1;
+    }
+    preempt_disable();
+    sched_lock();
+    Thread* thread = find_thread(tid);
+    if (thread == nullptr) {
+        sched_unlock();
+        preempt_enable();
+        return -1;
+    }
+    // A READY thread is queued at its level, so it is queued again at the new one
+    bool queued = realtime_policy.regular() == &mlfq_policy && thread -> state == ThreadState::READY;
+    if (queued) {
+        policy -> dequeue(thread);
+    }
+    thread -> priority = priority;
+    mlfq_policy.set_level(thread, priority);
+    if (queued) {
+        policy -> enqueue(thread);
+    }
+    sched_unlock();
+    preempt_enable();
+    return 0;
+}
+
+int uthread_set_weight(int tid, int weight) {
+    if (weight <= 0 || weight > MAX_WEIGHT) {
+        error_handler("weight must be between 1 and " + std::to_string(MAX_WEIGHT), LIBRARY_ERROR_IND);
+        return -1;
+    }
+    preempt_disable();
+    sched_lock();
+    Thread* thread = find_thread(tid);
+    if (thread == nullptr) {
+        sched_unlock();
+        preempt_enable();
+        return -1;
+    }
+    // The run time the thread was already charged for keeps its old weight
+    thread -> weight = weight;
+    sched_unlock();
+    preempt_enable();
+    return 0;
+}
+
+int uthread_set_realtime(int tid, int period, int budget, int deadline) {
+    if (carrier_count > 1) {
+        error_handler("the real-time class runs on a single carrier only", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    if (deadline == 0) {
+        deadline = period;
+    }
+    if (budget != 0 && (budget < 0 || deadline < budget || period < deadline)) {
+        error_handler("budget, deadline and period must satisfy 0 < budget <= deadline <= period", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    try {
+        preempt_disable();
+        sched_lock();
+        Thread* thread = find_thread(tid);
+        if (thread != nullptr && thread -> exited) {
+            error_handler("tid not found", LIBRARY_ERROR_IND);
+            thread = nullptr;
+        }
+        if (thread == nullptr) {
+            sched_unlock();
+            preempt_enable();
+            return -1;
+        }
+        // A READY thread moves to the queue of its new class
+        bool queued = thread -> state == ThreadState::READY;
+        if (queued) {
+            policy -> dequeue(thread);
+        }
+        bool admitted = true;
+        if (budget == 0) {
+            realtime_policy.leave(thread);
+            select_policy();
+            if (thread == current_thread()) {
+                policy -> on_run(thread);
+            }
+        } else {
+            admitted = realtime_policy.admit(thread, period, budget, deadline, total_quantums);
+            select_policy();
+        }
+        if (queued) {
+            policy -> on_wake(thread);
+            policy -> enqueue(thread);
+            if (realtime_policy.preempts(current_thread(), thread)) {
+                current_carrier() -> preempt_pending = 1;
+            }
+        }
+        sched_unlock();
+        preempt_enable();
+        if (!admitted) {
+            error_handler("the real-time threads would take more than " + std::to_string(RT_MAX_UTILIZATION) +
+                          "% of the CPU", LIBRARY_ERROR_IND);
+            return -1;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        error_handler(e.what(), SYSTEM_ERROR_IND);
+        return -1;
+    }
+}
+
+int uthread_get_tid() {
+    return current_thread() -> id;
+}
+
+
+int uthread_get_total_quantums() {
+    if (ticks_stopped) {
+        preempt_disable();
+        if (ticks_stopped) {
+            count_stopped_quanta();
+        }
+        preempt_enable();
+    }
+    return total_quantums;
+
+}
+
+int uthread_get_quantums(int tid) {
+    // The thread table may be changed by a thread that terminates while this one is preempted in the middle of the
+    // lookup
+    preempt_disable();
+    sched_lock();
+    Thread* thread = find_thread(tid);
+    if (thread == nullptr) {
+        sched_unlock();
+        preempt_enable();
+        return -1;
+    }
+    if (ticks_stopped) {
+        count_stopped_quanta();
+    }
+    int quantums = thread->get_quantums();
+    sched_unlock();
+    preempt_enable();
+    return quantums;
+}
+
+int uthread_mutex_init(uthread_mutex* mutex) {
+    mutex -> owner = nullptr;
+    wait_queue_init(&mutex -> waiters);
+    return 0;
+}
+
+int uthread_mutex_lock(uthread_mutex* mutex) {
+    preempt_disable();
+    sched_lock();
+    Thread* self = current_thread();
+    if (mutex -> owner == self) {
+        sched_unlock();
+        preempt_enable();
+        error_handler("mutex is already locked by this thread", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    if (mutex -> owner == nullptr) {
+        mutex -> owner = self;
+        sched_unlock();
+    } else {
+        // The unlocking thread makes this one the owner before waking it up
+        park(&mutex -> waiters);
+    }
+    preempt_enable();
+    return 0;
+}
+
+/*
+ * Unlocks mutex, handing it to the first thread waiting for it. Called with the scheduler lock held.
+ */
+void release_mutex(uthread_mutex* mutex) {
+    if (wait_queue_empty(&mutex -> waiters)) {
+        mutex -> owner = nullptr;
+        return;
+    }
+    auto* next = static_cast<Thread*>(wait_queue_pop(&mutex -> waiters));
+    mutex -> owner = next;
+    unpark(next);
+}
+
+int uthread_mutex_unlock(uthread_mutex* mutex) {
+    preempt_disable();
+    sched_lock();
+    if (mutex -> owner != current_thread()) {
+        sched_unlock();
+        preempt_enable();
+        error_handler("mutex is not locked by this thread", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    release_mutex(mutex);
+    sched_unlock();
+    preempt_enable();
+    return 0;
+}
+
+int uthread_cond_init(uthread_cond* cond) {
+    wait_queue_init(&cond -> waiters);
+    return 0;
+}
+
+int uthread_cond_wait(uthread_cond* cond, uthread_mutex* mutex) {
+    preempt_disable();
+    sched_lock();
+    Thread* self = current_thread();
+    if (mutex -> owner != self) {
+        sched_unlock();
+        preempt_enable();
+        error_handler("mutex is not locked by this thread", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    release_mutex(mutex);
+    self -> cond_mutex = mutex;
+    // The signalling thread moves this one to the mutex, which is handed back to it before it wakes up
+    park(&cond -> waiters);
+    preempt_enable();
+    return 0;
+}
+
+/*
+ * Moves the first thread waiting on cond to its mutex: it becomes the owner and READY if the mutex is unlocked, and
+ * waits for it otherwise. Called with the scheduler lock held.
+ */
+void signal_cond(uthread_cond* cond) {
+    auto* thread = static_cast<Thread*>(wait_queue_pop(&cond -> waiters));
+    uthread_mutex* mutex = thread -> cond_mutex;
+    thread -> cond_mutex = nullptr;
+    if (mutex -> owner == nullptr) {
+        mutex -> owner = thread;
+        unpark(thread);
+    } else {
+        wait_queue_push(&mutex -> waiters, thread);
+    }
+}
+
+int uthread_cond_signal(uthread_cond* cond) {
+    preempt_disable();
+    sched_lock();
+    if (!wait_queue_empty(&cond -> waiters)) {
+        signal_cond(cond);
+    }
+    sched_unlock();
+    preempt_enable();
+    return 0;
+}
+
+int uthread_cond_broadcast(uthread_cond* cond) {
+    preempt_disable();
+    sched_lock();
+    while (!wait_queue_empty(&cond -> waiters)) {
+        signal_cond(cond);
+    }
+    sched_unlock();
+    preempt_enable();
+    return 0;
+}
+
+int uthread_sem_init(uthread_sem* sem, unsigned int value) {
+    sem -> value = value;
+    wait_queue_init(&sem -> waiters);
+    return 0;
+}
+
+int uthread_sem_wait(uthread_sem* sem) {
+    preempt_disable();
+    sched_lock();
+    if (sem -> value > 0) {
+        sem -> value--;
+        sched_unlock();
+    } else {
+        // The posting thread passes its increment straight to this one
+        park(&sem -> waiters);
+    }
+    preempt_enable();
+    return 0;
+}
+
+int uthread_sem_post(uthread_sem* sem) {
+    preempt_disable();
+    sched_lock();
+    if (wait_queue_empty(&sem -> waiters)) {
+        sem -> value++;
+    } else {
+        unpark(wait_queue_pop(&sem -> waiters));
+    }
+    sched_unlock();
+    preempt_enable();
+    return 0;
+}
+
+int uthread_channel_init(uthread_channel* channel, size_t capacity) {
+    try {
+        channel -> buffer = capacity > 0 ? new void*[capacity] : nullptr;
+    } catch (const std::exception& e) {
+        error_handler(e.what(), SYSTEM_ERROR_IND);
+        return -1;
+    }
+    channel -> capacity = capacity;
+    channel -> head = 0;
+    channel -> count = 0;
+    channel -> closed = 0;
+    wait_queue_init(&channel -> senders);
+    wait_queue_init(&channel -> receivers);
+    return 0;
+}
+
+/*
+ * Appends value to the buffer of channel, which must not be full.
+ */
+void channel_push(uthread_channel* channel, void* value) {
+    channel -> buffer[(channel -> head + channel -> count) % channel -> capacity] = value;
+    channel -> count++;
+}
+
+int uthread_channel_send(uthread_channel* channel, void* value) {
+    preempt_disable();
+    sched_lock();
+    if (channel -> closed) {
+        sched_unlock();
+        preempt_enable();
+        error_handler("channel is closed", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    if (!wait_queue_empty(&channel -> receivers)) {
+        // The buffer is empty, so the value goes straight to the receiver that waited longest
+        Waiter* receiver = wait_queue_pop(&channel -> receivers);
+        receiver -> transfer = value;
+        receiver -> wait_result = 0;
+        unpark(receiver);
+        sched_unlock();
+    } else if (channel -> count < channel -> capacity) {
+        channel_push(channel, value);
+        sched_unlock();
+    } else {
+        // A receiver moves the value into the buffer (or takes it) and wakes this thread, or close fails it
+        Thread* self = current_thread();
+        self -> transfer = value;
+        park(&channel -> senders);
+        if (self -> wait_result != 0) {
+            preempt_enable();
+            error_handler("channel is closed", LIBRARY_ERROR_IND);
+            return -1;
+        }
+    }
+    preempt_enable();
+    return 0;
+}
+
+/*
+ * Receives the oldest value on channel into *value, if it need not wait for one. Returns 0 on success, 1 if the
+ * channel is closed and drained, and -1 if the receiver must wait. Called with the scheduler lock held.
+ */
+int take_from_channel(uthread_channel* channel, void** value) {
+    if (channel -> count > 0) {
+        *value = channel -> buffer[channel -> head];
+        channel -> head = (channel -> head + 1) % channel -> capacity;
+        channel -> count--;
+        // A slot is free for the sender that waited longest
+        if (!wait_queue_empty(&channel -> senders)) {
+            Waiter* sender = wait_queue_pop(&channel -> senders);
+            channel_push(channel, sender -> transfer);
+            sender -> wait_result = 0;
+            unpark(sender);
+        }
+        return 0;
+    }
+    if (!wait_queue_empty(&channel -> senders)) {
+        // Only without a buffer: the value is taken straight from the sender
+        Waiter* sender = wait_queue_pop(&channel -> senders);
+        *value = sender -> transfer;
+        sender -> wait_result = 0;
+        unpark(sender);
+        return 0;
+    }
+    return channel -> closed ? 1 : -1;
+}
+
+int uthread_channel_receive(uthread_channel* channel, void** value) {
+    preempt_disable();
+    sched_lock();
+    int result = take_from_channel(channel, value);
+    if (result >= 0) {
+        sched_unlock();
+    } else {
+        Thread* self = current_thread();
+        park(&channel -> receivers);
+        // A sender left the value in transfer, or close woke this thread up
+        result = self -> wait_result;
+        if (result == 0) {
+            *value = self -> transfer;
+        }
+    }
+    preempt_enable();
+    return result;
+}
+
+int uthread_channel_close(uthread_channel* channel) {
+    preempt_disable();
+    sched_lock();
+    if (channel -> closed) {
+        sched_unlock();
+        preempt_enable();
+        error_handler("channel is already closed", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    channel -> closed = 1;
+    while (!wait_queue_empty(&channel -> receivers)) {
+        Waiter* receiver = wait_queue_pop(&channel -> receivers);
+        receiver -> wait_result = 1;
+        unpark(receiver);
+    }
+    while (!wait_queue_empty(&channel -> senders)) {
+        Waiter* sender = wait_queue_pop(&channel -> senders);
+        sender -> wait_result = -1;
+        unpark(sender);
+    }
+    sched_unlock();
+    preempt_enable();
+    return 0;
+}
+
+int uthread_channel_destroy(uthread_channel* channel) {
+    preempt_disable();
+    sched_lock();
+    if (!wait_queue_empty(&channel -> senders) || !wait_queue_empty(&channel -> receivers)) {
+        sched_unlock();
+        preempt_enable();
+        error_handler("threads are waiting on the channel", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    delete[] channel -> buffer;
+    channel -> buffer = nullptr;
+    sched_unlock();
+    preempt_enable();
+    return 0;
+}
+
+/*
+ * Queues waiter for fd to be ready for direction (EPOLLIN or EPOLLOUT), and arms fd. Returns 0, or -1 with errno set
+ * (and waiter not queued) if fd cannot be waited on. Called with the scheduler lock held.
+ */
+int queue_for_fd(int fd, uint32_t direction, Waiter* waiter) {
+    uthread_wait_queue* queue;
+    try {
+        queue = reactor.waiters(fd, direction);
+    } catch (const std::bad_alloc&) {
+        errno = ENOMEM;
+        return -1;
+    }
+    // The fd is armed for the waiters it has, this one included
+    wait_queue_push(queue, waiter);
+    if (!reactor.arm(fd)) {
+        int error = errno;
+        wait_queue_remove(waiter);
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Parks the running thread until fd is ready for direction (EPOLLIN or EPOLLOUT). Returns 0 once the call that found
+ * fd not ready may be retried, or -1 with errno set if fd cannot be waited on.
+ */
+int wait_for_fd(int fd, uint32_t direction) {
+    preempt_disable();
+    sched_lock();
+    Thread* self = current_thread();
+    if (self -> state == ThreadState::TERMINATED) {
+        stop_current(self);
+    }
+    if (queue_for_fd(fd, direction, self) < 0) {
+        int error = errno;
+        sched_unlock();
+        preempt_enable();
+        errno = error;
+        return -1;
+    }
+    leave_for_queue(self);
+    preempt_enable();
+    return 0;
+}
+
+/*
+ * Puts fd in non-blocking mode, so the calls on it return EAGAIN instead of blocking the carrier.
+ */
+int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0) {
+        return -1;
+    }
+    if ((flags & O_NONBLOCK) == 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Whether a call on a non-blocking fd that failed should be retried, after waiting for fd when it was not ready.
+ */
+bool retry_io(int fd, uint32_t direction) {
+    if (errno == EINTR) {
+        return true;
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        return false;
+    }
+    return wait_for_fd(fd, direction) == 0;
+}
+
+ssize_t uthread_read(int fd, void* buf, size_t count) {
+    if (set_nonblocking(fd) < 0) {
+        return -1;
+    }
+    while (true) {
+        ssize_t result = read(fd, buf, count);
+        if (result >= 0 || !retry_io(fd, EPOLLIN)) {
+            return result;
+        }
+    }
+}
+
+ssize_t uthread_write(int fd, const void* buf, size_t count) {
+    if (set_nonblocking(fd) < 0) {
+        return -1;
+    }
+    while (true) {
+        ssize_t result = write(fd, buf, count);
+        if (result >= 0 || !retry_io(fd, EPOLLOUT)) {
+            return result;
+        }
+    }
+}
+
+int uthread_accept(int fd, struct sockaddr* addr, socklen_t* addrlen) {
+    if (set_nonblocking(fd) < 0) {
+        return -1;
+    }
+    while (true) {
+        int result = accept4(fd, addr, addrlen, SOCK_NONBLOCK);
+        if (result >= 0 || !retry_io(fd, EPOLLIN)) {
+            return result;
+        }
+    }
+}
+
+int uthread_connect(int fd, const struct sockaddr* addr, socklen_t addrlen) {
+    if (set_nonblocking(fd) < 0) {
+        return -1;
+    }
+    if (connect(fd, addr, addrlen) == 0) {
+        return 0;
+    }
+    // The connection goes on in the background (an interrupted connect too), and the socket becomes writable when it
+    // is done
+    if (errno != EINPROGRESS && errno != EINTR) {
+        return -1;
+    }
+    if (wait_for_fd(fd, EPOLLOUT) < 0) {
+        return -1;
+    }
+    int error = 0;
+    socklen_t size = sizeof(error);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size) < 0) {
+        return -1;
+    }
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+int uthread_trace_start(size_t max_events) {
+    if (max_events == 0) {
+        error_handler("max_events must be positive", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    tracer.calibrate();
+    preempt_disable();
+    sched_lock();
+    if (tracer.enabled()) {
+        sched_unlock();
+        preempt_enable();
+        error_handler("tracing is already on", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    try {
+        tracer.start(max_events);
+    } catch (const std::bad_alloc& e) {
+        sched_unlock();
+        preempt_enable();
+        error_handler(e.what(), SYSTEM_ERROR_IND);
+        return -1;
+    }
+    // The caller's run is counted from now on
+    tracer.start_running(&current_thread() -> stats, Tracer::now());
+    sched_unlock();
+    preempt_enable();
+    return 0;
+}
+
+int uthread_trace_stop() {
+    preempt_disable();
+    sched_lock();
+    if (!tracer.enabled()) {
+        sched_unlock();
+        preempt_enable();
+        error_handler("tracing is off", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    tracer.stop_running(&current_thread() -> stats, Tracer::now());
+    tracer.stop();
+    sched_unlock();
+    preempt_enable();
+    return 0;
+}
+
+int uthread_trace_export(const char* path) {
+    if (tracer.enabled()) {
+        error_handler("cannot export while tracing is on", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    if (!tracer.export_json(path)) {
+        error_handler(std::string("cannot write ") + path, LIBRARY_ERROR_IND);
+        return -1;
+    }
+    return 0;
+}
+
+int uthread_get_stats(int tid, uthread_stats* stats) {
+    preempt_disable();
+    sched_lock();
+    Thread* thread = find_thread(tid);
+    if (thread == nullptr) {
+        sched_unlock();
+        preempt_enable();
+        return -1;
+    }
+    tracer.fill(&thread -> stats, stats);
+    sched_unlock();
+    preempt_enable();
+    return 0;
+}
+
+int uthread_key_create(uthread_key* key, uthread_key_destructor destructor) {
+    preempt_disable();
+    sched_lock();
+    int count = key_count.load(std::memory_order_relaxed);
+    if (count == UTHREAD_KEYS_MAX) {
+        sched_unlock();
+        preempt_enable();
+        error_handler("too many keys", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    key_destructors[count] = destructor;
+    key_count.store(count + 1, std::memory_order_release);
+    sched_unlock();
+    preempt_enable();
+    *key = count;
+    return 0;
+}
+
+void* uthread_getspecific(uthread_key key) {
+    // The running thread may move to another carrier right after this, but it stays the same Thread
+    if ((unsigned) key >= (unsigned) key_count.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    return current_thread() -> specific[key];
+}
+
+int uthread_setspecific(uthread_key key, const void* value) {
+    if ((unsigned) key >= (unsigned) key_count.load(std::memory_order_acquire)) {
+        error_handler("invalid key", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    current_thread() -> specific[key] = (void*) value;
+    return 0;
+}
+
+/*
+ * Queues a coroutine whose wait is over for the coroutine runner, and wakes the runner up if it is parked.
+ */
+void make_coroutine_ready(Waiter* waiter) {
+    wait_queue_push(&ready_coroutines, waiter);
+    if (!wait_queue_empty(&coroutine_runner_queue)) {
+        unpark(wait_queue_pop(&coroutine_runner_queue));
+    }
+}
+
+/*
+ * The coroutine runner: resumes the ready coroutines in FIFO order, each until it suspends again or ends, and parks
+ * while there are none. It is scheduled like any other thread, so the coroutines share its quanta.
+ */
+void* run_coroutines(void*) {
+    preempt_disable();
+    sched_lock();
+    while (true) {
+        if (wait_queue_empty(&ready_coroutines)) {
+            park(&coroutine_runner_queue);
+            sched_lock();
+            continue;
+        }
+        std::coroutine_handle<> coroutine = wait_queue_pop(&ready_coroutines) -> coroutine;
+        sched_unlock();
+        preempt_enable();
+        coroutine.resume();
+        preempt_disable();
+        sched_lock();
+    }
+}
+
+int coroutine_spawn(Waiter* start) {
+    preempt_disable();
+    sched_lock();
+    if (!coroutine_runner_spawned) {
+        coroutine_runner_spawned = true;
+        sched_unlock();
+        preempt_enable();
+        uthread_attr attr;
+        uthread_attr_init(&attr);
+        attr.stack_size = COROUTINE_STACK_SIZE;
+        if (uthread_spawn_ex(&run_coroutines, nullptr, &attr) < 0) {
+            preempt_disable();
+            sched_lock();
+            coroutine_runner_spawned = false;
+            sched_unlock();
+            preempt_enable();
+            return -1;
+        }
+        preempt_disable();
+        sched_lock();
+    }
+    make_coroutine_ready(start);
+    sched_unlock();
+    preempt_enable();
+    return 0;
+}
+
+void coroutine_yield(Waiter* waiter) {
+    preempt_disable();
+    sched_lock();
+    wait_queue_push(&ready_coroutines, waiter);
+    sched_unlock();
+    preempt_enable();
+}
+
+bool coroutine_sleep(Waiter* waiter, uint64_t deadline_nsecs) {
+    preempt_disable();
+    sched_lock();
+    if (deadline_nsecs <= monotonic_nsecs()) {
+        sched_unlock();
+        preempt_enable();
+        return false;
+    }
+    try {
+        deadline_sleepers.insert(waiter, deadline_nsecs);
+    } catch (const std::bad_alloc& e) {
+        sched_unlock();
+        preempt_enable();
+        error_handler(e.what(), SYSTEM_ERROR_IND);
+        return false;
+    }
+    if (deadline_sleepers.next_deadline() == deadline_nsecs) {
+        arm_deadline_timer();
+    }
+    sched_unlock();
+    preempt_enable();
+    return true;
+}
+
+int coroutine_receive(uthread_channel* channel, Waiter* waiter, void** value) {
+    preempt_disable();
+    sched_lock();
+    int result = take_from_channel(channel, value);
+    if (result < 0) {
+        wait_queue_push(&channel -> receivers, waiter);
+    }
+    sched_unlock();
+    preempt_enable();
+    return result;
+}
 
+int coroutine_wait_fd(int fd, uint32_t direction, Waiter* waiter) {
+    preempt_disable();
+    sched_lock();
+    int result = queue_for_fd(fd, direction, waiter);
+    int error = errno;
+    sched_unlock();
+    preempt_enable();
+    errno = error;
+    return result;
+}
+
+int uthread_preempt_disable() {
+    Thread* self = current_thread();
+    if (self == nullptr) {
+        return 0;
+    }
+    if (self -> preempt_disabled) {
+        error_handler("preemption is already disabled", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    preempt_disable();
+    return 0;
+}
+
+int uthread_preempt_enable() {
+    Thread* self = current_thread();
+    if (self == nullptr) {
+        return 0;
+    }
+    if (!self -> preempt_disabled) {
+        error_handler("preemption is not disabled", LIBRARY_ERROR_IND);
+        return -1;
+    }
+    preempt_enable();
+    return 0;
+}
+
+/*
+ * Disables preemption for a call into the allocator, unless it is disabled already (a frame freed while
+ * coroutine_destroy runs, or by a call of the library) or the library is not initialized yet. Returns whether it did.
+ */
+bool preempt_disable_for_allocator() {
+    Thread* self = current_thread();
+    if (self == nullptr || self -> preempt_disabled) {
+        return false;
+    }
+    preempt_disable();
+    return true;
+}
+
+void* coroutine_frame_alloc(size_t size) {
+    bool disabled = preempt_disable_for_allocator();
+    void* frame = malloc(size);
+    if (disabled) {
+        preempt_enable();
+    }
+    if (frame == nullptr) {
+        throw std::bad_alloc();
+    }
+    return frame;
+}
+
+void coroutine_frame_free(void* frame) {
+    bool disabled = preempt_disable_for_allocator();
+    free(frame);
+    if (disabled) {
+        preempt_enable();
+    }
+}
+
+void coroutine_destroy(std::coroutine_handle<> coroutine) {
+    bool disabled = preempt_disable_for_allocator();
+    coroutine.destroy();
+    if (disabled) {
+        preempt_enable();
+    }
+}
@@ -6,11 +6,108 @@
 #ifndef _UTHREADS_H
 #define _UTHREADS_H
 
+#include <cstddef>
+#include <cstdint>
+#include <sys/socket.h>
+#include <sys/types.h>
 
-#define MAX_THREAD_NUM 100 /* maximal number of threads */
+#define MAX_THREAD_NUM 100 /* default maximal number of threads */
 #define STACK_SIZE 4096 /* stack size per thread (in bytes) */
+#define MAX_STACK_SIZE (1UL << 30) /* largest stack a thread can be spawned with (in bytes) */
+#define MAX_CARRIERS 64 /* maximal number of kernel threads running uthreads */
+#define PRIORITY_LEVELS 4 /* priority levels of the MLFQ scheduler, 0 is the highest */
+#define MLFQ_RESET_QUANTA 100 /* the MLFQ scheduler moves every thread to the top level once every this many quanta */
+#define DEFAULT_WEIGHT 1024 /* a thread's share of the CPU under the fair scheduler, unless set otherwise */
+#define MAX_WEIGHT (1 << 20)
+#define RT_MAX_UTILIZATION 90 /* percent of the CPU the real-time threads may reserve together */
+#define UTHREAD_LATENCY_BUCKETS 32 /* buckets of the scheduling latency histogram, see uthread_stats */
+#define UTHREAD_KEYS_MAX 32 /* thread-specific data keys a process can create */
+#define UTHREAD_DESTRUCTOR_ITERATIONS 4 /* rounds of key destructors run for a thread that ends */
+
+/* scheduling policies, see uthread_set_scheduler */
+#define UTHREAD_SCHED_RR 0
+#define UTHREAD_SCHED_MLFQ 1
+#define UTHREAD_SCHED_FAIR 2
 
 typedef void (*thread_entry_point)(void);
+typedef void* (*uthread_start_routine)(void* arg);
+typedef int uthread_key;
+typedef void (*uthread_key_destructor)(void* value);
+
+class Thread;
+struct Waiter;
+
+/*
+ * The scheduling statistics of a thread since tracing started (see uthread_trace_start): how long it ran and how long
+ * it waited READY, in nanoseconds, how many times it was switched to, and a histogram of its scheduling latencies,
+ * the times from being made READY to running. latency_histogram[i] counts the latencies of 2^i to 2^(i+1) - 1 ns;
+ * the first bucket also counts shorter ones and the last one longer ones.
+ */
+typedef struct uthread_stats {
+    uint64_t run_nsecs;
+    uint64_t wait_nsecs;
+    uint64_t runs;
+    uint64_t latency_histogram[UTHREAD_LATENCY_BUCKETS];
+} uthread_stats;
+
+/*
+ * The threads (or coroutines) parked on a synchronization object, in FIFO order. Managed by the library only.
+ */
+typedef struct uthread_wait_queue {
+    Waiter* head;
+    Waiter* tail;
+} uthread_wait_queue;
+
+/*
+ * A mutex. Unlocking it hands it straight to the first waiting thread, if any.
+ */
+typedef struct uthread_mutex {
+    Thread* owner;
+    uthread_wait_queue waiters;
+} uthread_mutex;
+
+typedef struct uthread_cond {
+    uthread_wait_queue waiters;
+} uthread_cond;
+
+typedef struct uthread_sem {
+    unsigned int value;
+    uthread_wait_queue waiters;
+} uthread_sem;
+
+/*
+ * A bounded FIFO channel of pointers. Holds up to capacity values in a ring buffer; a value sent while a receiver
+ * waits goes straight to the receiver.
+ */
+typedef struct uthread_channel {
+    void** buffer;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    int closed;
+    uthread_wait_queue senders;
+    uthread_wait_queue receivers;
+} uthread_channel;
+
+/*
+ * Attributes of a thread spawned with uthread_spawn_ex. Set to the defaults with uthread_attr_init, then change the
+ * fields that matter.
+ */
+typedef struct uthread_attr {
+    size_t stack_size;  /* bytes of stack for the thread's own use (STACK_SIZE by default) */
+    int lazy_stack;     /* if non-zero (the default) the stack is only reserved, and memory is committed page by page
+                           as the thread first touches it. If zero, the whole stack is committed by the spawn, so the
+                           thread never page faults on it */
+    int priority;       /* the MLFQ level the thread starts at, from 0 (the default, and the highest) to
+                           PRIORITY_LEVELS - 1. The round-robin scheduler ignores it */
+    int weight;         /* the thread's share of the CPU under the fair scheduler, relative to the weights of the
+                           other threads, from 1 to MAX_WEIGHT (DEFAULT_WEIGHT by default) */
+    int affinity;       /* the carrier the thread would rather run on, or -1 (the default) for any. A hint: the
+                           thread first waits for that carrier, but other carriers may steal it later */
+    int joinable;       /* if non-zero the thread is kept once it ends, holding on to its ID, until uthread_join
+                           collects its result or uthread_detach lets it go. If zero (the default) it is deleted as
+                           soon as it ends */
+} uthread_attr;
 
 /* External interface */
 
@@ -24,10 +121,17 @@ typedef void (*thread_entry_point)(void);
  * exactly once.
  * The input to the function is the length of a quantum in micro-seconds.
  * It is an error to call this function with non-positive quantum_usecs.
+ * max_threads is the maximal number of concurrent threads, including the main thread. It must be positive and at most
+ * 2^24. Memory for the thread table grows with the threads actually spawned, not with max_threads.
+ * carrier_threads is the number of kernel threads ("carriers") that run the uthreads, between 1 and MAX_CARRIERS.
+ * The calling thread is the first carrier; the others are created here and never exit. Every carrier has its own
+ * READY threads and steals from the others when it runs out, and its quantum is measured on its own CPU time. With
+ * more than one carrier, threads run in parallel and the total quantum count is shared by all carriers, and a thread
+ * blocked or terminated while it runs on another carrier stops at that carrier's next quantum.
  *
  * @return On success, return 0. On failure, return -1.
 */
-int uthread_init(int quantum_usecs);
+int uthread_init(int quantum_usecs, int max_threads = MAX_THREAD_NUM, int carrier_threads = 1);
 
 /**
  * @brief Creates a new thread, whose entry point is the function entry_point with the signature
@@ -35,14 +139,84 @@ int uthread_init(int quantum_usecs);
  *
  * The thread is added to the end of the READY threads list.
  * The uthread_spawn function should fail if it would cause the number of concurrent threads to exceed the
- * limit (MAX_THREAD_NUM).
+ * limit (max_threads of uthread_init).
+ * The low bits of the ID are the smallest index not taken by an existing thread, and the bits above them count how
+ * many threads used that index before, so the ID of a terminated thread is not given to a new one (and is an error
+ * to pass to any function) until that count wraps around. The first threads get the IDs 1, 2, 3...
  * Each thread should be allocated with a stack of size STACK_SIZE bytes.
+ * The stack comes from a pool of recycled stacks with a guard page below each one, and has extra room for the frame
+ * of the timer signal, which is delivered on it.
  * It is an error to call this function with a null entry_point.
  *
  * @return On success, return the ID of the created thread. On failure, return -1.
 */
 int uthread_spawn(thread_entry_point entry_point);
 
+/**
+ * @brief Creates n threads at once, the i-th of which has the entry point entries[i], and stores their IDs in
+ * tids_out[0..n-1] (unless tids_out is null).
+ *
+ * Does what n calls of uthread_spawn would, in order, but takes the scheduler lock once. Either every thread is
+ * created or none is: the function fails if it would cause the number of concurrent threads to exceed the limit.
+ * It is an error to call this function with n smaller than 1 or with a null entry point.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_spawn_many(const thread_entry_point* entries, int n, int* tids_out);
+
+
+/**
+ * @brief Sets attr to the default attributes, the ones uthread_spawn uses.
+*/
+void uthread_attr_init(uthread_attr* attr);
+
+
+/**
+ * @brief Creates a new thread that runs entry(arg), with the given attributes.
+ *
+ * Behaves as uthread_spawn, except that the entry point gets an argument, that returning from it ends the thread with
+ * the value it returns as its result (see uthread_join) and that the thread is created with the attributes in attr, or
+ * with the defaults if attr is null.
+ * It is an error to call this function with a null entry, with a stack_size above MAX_STACK_SIZE, with a priority
+ * that is not between 0 and PRIORITY_LEVELS - 1 or with a weight that is not between 1 and MAX_WEIGHT.
+ *
+ * @return On success, return the ID of the created thread. On failure, return -1.
+*/
+int uthread_spawn_ex(uthread_start_routine entry, void* arg, const uthread_attr* attr);
+
+
+/**
+ * @brief Creates a new joinable thread that runs entry(arg), with the default attributes otherwise.
+ *
+ * The thread ends when entry returns (or when it is terminated, with a null result), and keeps its ID until another
+ * thread joins it with uthread_join or it is detached with uthread_detach. Every thread spawned this way should be
+ * either joined or detached, or it keeps counting in the limit on the number of threads.
+ *
+ * @return On success, return the ID of the created thread. On failure, return -1.
+*/
+int uthread_spawn_arg(uthread_start_routine entry, void* arg);
+
+
+/**
+ * @brief Waits until the joinable thread with ID tid ends, stores its result in *result (unless result is null) and
+ * deletes it, so its ID may be reused.
+ *
+ * Returns at once if the thread has already ended. It is an error to join a thread that does not exist, that is not
+ * joinable (the main thread included), that another thread is already joining, or the calling thread itself.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_join(int tid, void** result);
+
+
+/**
+ * @brief Makes the joinable thread with ID tid detached: it is deleted as soon as it ends, or now if it has already
+ * ended. It is an error to detach a thread that does not exist, that is not joinable or that is being joined.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_detach(int tid);
+
 
 /**
  * @brief Terminates the thread with ID tid and deletes it from all relevant control structures.
@@ -89,12 +263,99 @@ int uthread_resume(int tid);
  * at the same time, the order in which they're added to the end of the READY queue doesn't matter.
  * The number of quantums refers to the number of times a new quantum starts, regardless of the reason. Specifically,
  * the quantum of the thread which has made the call to uthread_sleep isn’t counted.
+ * While no thread at all is runnable the process sleeps, and a new quantum starts every quantum_usecs of real time.
  * It is considered an error if the main thread (tid == 0) calls this function.
  *
  * @return On success, return 0. On failure, return -1.
 */
 int uthread_sleep(int num_quantums);
 
+/**
+ * @brief Blocks the RUNNING thread until CLOCK_MONOTONIC reaches deadline_nsecs (an absolute time, in nanoseconds, as
+ * clock_gettime reports it), independently of the quanta.
+ *
+ * The thread is made READY as soon as the deadline passes, which starts a new quantum. A deadline that has already
+ * passed returns right away. It is considered an error if the main thread (tid == 0) calls this function.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_sleep_ns(uint64_t deadline_nsecs);
+
+
+/**
+ * @brief Moves the RUNNING thread to the end of the READY queue and switches to the next READY thread.
+ *
+ * The switch is made right away, without resetting the timer and without changing the signal mask, so it makes no
+ * system calls. The next thread starts a new quantum (both quantum counters are increased as for any other switch)
+ * but runs only for what is left of the current timer interval. If no other thread is READY the function returns
+ * immediately and the calling thread keeps running.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_yield();
+
+
+/**
+ * @brief Chooses how the READY threads are scheduled, from then on.
+ *
+ * UTHREAD_SCHED_RR (the default) is round-robin over a single FIFO, every thread running for one quantum at a time.
+ * UTHREAD_SCHED_MLFQ is a multilevel feedback queue with PRIORITY_LEVELS levels: the first thread of the highest
+ * non-empty level runs next, and a thread on level l runs for 2^l quanta before it is preempted (this still counts as
+ * a single quantum). A thread that is preempted moves down a level, and a thread that blocks or sleeps itself moves up
+ * a level. Once every MLFQ_RESET_QUANTA quanta every thread is moved to the highest level, so no thread starves.
+ * Under MLFQ a thread switched to by uthread_yield gets a full quantum of its level.
+ * UTHREAD_SCHED_FAIR gives every thread a share of the CPU proportional to its weight: the thread that ran for the
+ * least time, scaled by DEFAULT_WEIGHT / weight, runs next for a quantum. Run time is measured on the monotonic clock,
+ * and a thread that wakes up from blocking or sleeping is at most a quantum behind the others.
+ * The threads that are READY when the policy changes keep the order the old policy would have run them in.
+ * Only round-robin can be used with more than one carrier. Whatever the policy, the real-time threads (see
+ * uthread_set_realtime) run before the threads it orders.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_scheduler(int policy);
+
+
+/**
+ * @brief Moves the thread with ID tid to the given level of the MLFQ, from where it moves on as any other thread.
+ *
+ * It is an error if no thread with ID tid exists, or if priority is not between 0 and PRIORITY_LEVELS - 1. The
+ * round-robin scheduler ignores priorities.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_priority(int tid, int priority);
+
+
+/**
+ * @brief Sets the weight of the thread with ID tid, its share of the CPU under the fair scheduler.
+ *
+ * It is an error if no thread with ID tid exists, or if weight is not between 1 and MAX_WEIGHT. The other schedulers
+ * ignore weights.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_weight(int tid, int weight);
+
+
+/**
+ * @brief Moves the thread with ID tid to the real-time class, or back to the regular one if budget is 0.
+ *
+ * A real-time thread may run for budget quanta every period quanta, and should have run for them within deadline
+ * quanta of the start of the period (deadline 0 stands for period). Real-time threads with budget left run before
+ * every regular thread, the one with the earliest deadline first, and one that is made READY with an earlier deadline
+ * than the running thread preempts it right away, so it waits for no tick. A thread that used up its budget runs only
+ * when no other thread is READY, until its next period starts. A period starts when the thread runs or is made READY
+ * at least period quanta after the last one did, and the first one starts now.
+ * Admission control: it is an error if the densities budget / deadline of the real-time threads would add up to more
+ * than RT_MAX_UTILIZATION percent of the CPU, which leaves every admitted thread its budget before its deadline, as
+ * long as it is READY when its period starts. It is also an error if no thread with ID tid exists, if the parameters
+ * do not satisfy 0 < budget <= deadline <= period, or if there is more than one carrier.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_realtime(int tid, int period, int budget, int deadline);
+
 
 /**
  * @brief Returns the thread ID of the calling thread.
@@ -127,4 +388,207 @@ int uthread_get_total_quantums();
 int uthread_get_quantums(int tid);
 
 
+/**
+ * @brief Disables preemption of the calling thread until uthread_preempt_enable: it keeps the CPU, and a quantum that
+ * ends meanwhile ends when preemption is enabled again.
+ *
+ * The library does not make the allocator safe to preempt. With one carrier glibc takes no locks, so a thread
+ * preempted in the middle of malloc or free while another thread allocates corrupts the heap; with several carriers a
+ * thread preempted while it holds an arena lock can leave the other carriers spinning on it. Every call that may
+ * allocate or free memory (malloc, free, new, delete, and the standard library containers, streams and strings that
+ * use them) must be made between uthread_preempt_disable and uthread_preempt_enable. The calls do not nest, and no
+ * other function of the library may be called in between, since every one of them enables preemption when it returns.
+ * Before uthread_init both do nothing.
+ *
+ * @return On success, return 0. On failure (preemption is already disabled), return -1.
+*/
+int uthread_preempt_disable();
+
+
+/**
+ * @brief Enables preemption of the calling thread again, ending the quantum right away if it ended while preemption
+ * was disabled.
+ *
+ * @return On success, return 0. On failure (preemption is not disabled by uthread_preempt_disable), return -1.
+*/
+int uthread_preempt_enable();
+
+
+/*
+ * Synchronization objects. A thread that has to wait is parked on the object itself, with no busy waiting: it leaves
+ * the CPU right away, as if it blocked itself, and is made READY by the call that gives it what it waits for (so it
+ * never waits for its turn again). The main thread may wait too. A thread that waits is BLOCKED, but it is not
+ * affected by uthread_resume: a thread that is blocked with uthread_block while it waits stays BLOCKED until it is
+ * both given what it waited for and resumed. A thread terminated while it waits is taken off the object; a mutex
+ * locked by a terminated thread stays locked. The objects need no destruction, except for channels.
+ * All functions return 0 on success and -1 on failure.
+ */
+
+/**
+ * @brief Initializes mutex as unlocked.
+*/
+int uthread_mutex_init(uthread_mutex* mutex);
+
+/**
+ * @brief Locks mutex, waiting until it is handed to the calling thread if it is locked. It is an error to lock a
+ * mutex the calling thread already holds.
+*/
+int uthread_mutex_lock(uthread_mutex* mutex);
+
+/**
+ * @brief Unlocks mutex, which must be locked by the calling thread. If threads wait for it, it is handed to the first
+ * one, which becomes READY.
+*/
+int uthread_mutex_unlock(uthread_mutex* mutex);
+
+/**
+ * @brief Initializes cond with no waiting threads.
+*/
+int uthread_cond_init(uthread_cond* cond);
+
+/**
+ * @brief Unlocks mutex, which must be locked by the calling thread, and waits until cond is signalled and mutex is
+ * handed back to the calling thread.
+*/
+int uthread_cond_wait(uthread_cond* cond, uthread_mutex* mutex);
+
+/**
+ * @brief Wakes the first thread waiting on cond (uthread_cond_signal) or all of them (uthread_cond_broadcast). A woken
+ * thread takes its mutex if it is unlocked, and otherwise waits for it without becoming READY in between.
+*/
+int uthread_cond_signal(uthread_cond* cond);
+int uthread_cond_broadcast(uthread_cond* cond);
+
+/**
+ * @brief Initializes sem with the given value.
+*/
+int uthread_sem_init(uthread_sem* sem, unsigned int value);
+
+/**
+ * @brief Decrements sem, waiting until it is posted if its value is 0.
+*/
+int uthread_sem_wait(uthread_sem* sem);
+
+/**
+ * @brief Increments sem, or, if threads wait on it, makes the first one READY instead.
+*/
+int uthread_sem_post(uthread_sem* sem);
+
+/**
+ * @brief Initializes channel, with room for capacity values. With capacity 0 every send waits for a receiver.
+*/
+int uthread_channel_init(uthread_channel* channel, size_t capacity);
+
+/**
+ * @brief Sends value on channel, waiting while the channel is full. It is an error to send on a closed channel, and a
+ * send still waiting when the channel is closed fails.
+*/
+int uthread_channel_send(uthread_channel* channel, void* value);
+
+/**
+ * @brief Receives the oldest value on channel into *value, waiting while the channel is empty.
+ *
+ * @return 0 on success, 1 if the channel is closed and every value sent was received, -1 on failure.
+*/
+int uthread_channel_receive(uthread_channel* channel, void** value);
+
+/**
+ * @brief Closes channel: the values already sent can still be received, and then every receive returns 1. The threads
+ * waiting to send fail, and the threads waiting to receive get 1. It is an error to close a channel twice.
+*/
+int uthread_channel_close(uthread_channel* channel);
+
+/**
+ * @brief Frees the buffer of channel. It is an error to destroy a channel threads wait on.
+*/
+int uthread_channel_destroy(uthread_channel* channel);
+
+/**
+ * @brief Reads from fd like read(2), but a call that would block parks the calling thread instead of the kernel
+ * thread, until fd is readable; the other threads keep running meanwhile. A parked thread is BLOCKED until then, and
+ * uthread_resume does not wake it. fd is put in non-blocking mode.
+ *
+ * @return What read returns: the number of bytes read, 0 at end of file, or -1 with errno set.
+*/
+ssize_t uthread_read(int fd, void* buf, size_t count);
+
+/**
+ * @brief Writes to fd like write(2), parking the calling thread while fd is not writable, as uthread_read does.
+*/
+ssize_t uthread_write(int fd, const void* buf, size_t count);
+
+/**
+ * @brief Accepts a connection on the listening socket fd like accept(2), parking the calling thread until one comes,
+ * as uthread_read does. The accepted socket is non-blocking.
+*/
+int uthread_accept(int fd, struct sockaddr* addr, socklen_t* addrlen);
+
+/**
+ * @brief Connects the socket fd like connect(2), parking the calling thread until the connection is made or fails,
+ * as uthread_read does.
+*/
+int uthread_connect(int fd, const struct sockaddr* addr, socklen_t addrlen);
+
+/**
+ * @brief Starts tracing the scheduler: switches, preemptions, wakeups, blocks and sleeps are recorded, with TSC
+ * timestamps, in a ring buffer of the last max_events events (rounded up to a power of two), and every thread's
+ * uthread_stats are kept from now on. Tracing is off until this is called, and then costs a few nanoseconds per
+ * scheduler event. The first call takes a couple of milliseconds to measure the TSC frequency.
+ * It is an error to start tracing while it is already on.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_trace_start(size_t max_events);
+
+/**
+ * @brief Stops tracing. The events recorded and the statistics are kept until tracing starts again.
+*/
+int uthread_trace_stop();
+
+/**
+ * @brief Writes the recorded events to path as Chrome trace-event JSON (for chrome://tracing or Perfetto): a track
+ * per thread, showing when it ran and its other events. It is an error to export while tracing is on.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_trace_export(const char* path);
+
+/**
+ * @brief Stores the scheduling statistics of the thread with ID tid in *stats. They are all 0 for a thread that was
+ * not scheduled since tracing started.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_get_stats(int tid, uthread_stats* stats);
+
+/*
+ * Thread-specific data: a key names a slot every thread has, holding a pointer that is null until the thread sets it.
+ * The slots are stored in the thread itself, so uthread_getspecific and uthread_setspecific take no lock. Coroutines
+ * share the slots of the thread that runs them.
+ */
+
+/**
+ * @brief Creates a new key, stored in *key. Its value is null in every thread. When a thread ends, by returning from
+ * its entry point or terminating itself, each of its non-null values whose key has a destructor is set to null and
+ * the destructor is called with it, on the thread itself. Values set by the destructors are destroyed again, for up
+ * to UTHREAD_DESTRUCTOR_ITERATIONS rounds. No destructor runs for a thread terminated by another thread, or for the
+ * main thread. Keys are never deleted; it is an error to create more than UTHREAD_KEYS_MAX.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_key_create(uthread_key* key, uthread_key_destructor destructor);
+
+/**
+ * @brief Returns the calling thread's value for key, or null if it set none (or key was not created).
+*/
+void* uthread_getspecific(uthread_key key);
+
+/**
+ * @brief Sets the calling thread's value for key. It is an error to use a key that was not created.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_setspecific(uthread_key key, const void* value);
+
+
 #endif
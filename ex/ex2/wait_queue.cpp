@@ -0,0 +1,49 @@
+#include "wait_queue.h"
+#include "waiter.h"
+
+void wait_queue_init(uthread_wait_queue* queue) {
+    queue -> head = nullptr;
+    queue -> tail = nullptr;
+}
+
+bool wait_queue_empty(const uthread_wait_queue* queue) {
+    return queue -> head == nullptr;
+}
+
+void wait_queue_push(uthread_wait_queue* queue, Waiter* waiter) {
+    waiter -> wait_next = nullptr;
+    waiter -> wait_prev = queue -> tail;
+    if (queue -> tail != nullptr) {
+        queue -> tail -> wait_next = waiter;
+    } else {
+        queue -> head = waiter;
+    }
+    queue -> tail = waiter;
+    waiter -> wait_queue = queue;
+}
+
+Waiter* wait_queue_pop(uthread_wait_queue* queue) {
+    Waiter* waiter = queue -> head;
+    wait_queue_remove(waiter);
+    return waiter;
+}
+
+void wait_queue_remove(Waiter* waiter) {
+    uthread_wait_queue* queue = waiter -> wait_queue;
+    if (queue == nullptr) {
+        return;
+    }
+    if (waiter -> wait_prev != nullptr) {
+        waiter -> wait_prev -> wait_next = waiter -> wait_next;
+    } else {
+        queue -> head = waiter -> wait_next;
+    }
+    if (waiter -> wait_next != nullptr) {
+        waiter -> wait_next -> wait_prev = waiter -> wait_prev;
+    } else {
+        queue -> tail = waiter -> wait_prev;
+    }
+    waiter -> wait_next = nullptr;
+    waiter -> wait_prev = nullptr;
+    waiter -> wait_queue = nullptr;
+}
@@ -0,0 +1,26 @@
+#ifndef WAIT_QUEUE_H
+#define WAIT_QUEUE_H
+
+#include "uthreads.h"
+#include "waiter.h"
+
+/*
+ * The operations on uthread_wait_queue, the FIFO of threads (and coroutines) parked on a mutex, condition variable,
+ * semaphore, channel or file descriptor. The queue links its Waiters through their wait_next/wait_prev pointers, and
+ * Waiter::wait_queue points back at the queue (it is nullptr if the waiter is not waiting).
+ */
+
+void wait_queue_init(uthread_wait_queue* queue);
+
+bool wait_queue_empty(const uthread_wait_queue* queue);
+
+/* Appends waiter, which must not be waiting on any queue. */
+void wait_queue_push(uthread_wait_queue* queue, Waiter* waiter);
+
+/* Removes and returns the first waiter. The queue must not be empty. */
+Waiter* wait_queue_pop(uthread_wait_queue* queue);
+
+/* Removes waiter from the queue it is waiting on, if any. */
+void wait_queue_remove(Waiter* waiter);
+
+#endif // WAIT_QUEUE_H
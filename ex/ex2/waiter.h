@@ -0,0 +1,37 @@
+#ifndef WAITER_H
+#define WAITER_H
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+
+#include "uthreads.h"
+
+/*
+ * Whatever waits on a wait queue, in the deadline heap or for a file descriptor: a Thread, or a coroutine suspended in
+ * one of the awaitables of coroutine.h, which keeps its Waiter in its frame. Either way the structures it waits in
+ * link it intrusively, so a wait allocates nothing.
+ */
+struct Waiter {
+    // links of the wait queue the waiter is on, and the queue (nullptr if it is on none)
+    Waiter* wait_next;
+    Waiter* wait_prev;
+    uthread_wait_queue* wait_queue;
+
+    // the value a channel passes to or from it, and how the wait ended
+    void* transfer;
+    int wait_result;
+
+    // the CLOCK_MONOTONIC deadline it sleeps until, and its position in the deadline heap
+    uint64_t wake_nsecs;
+    size_t deadline_index;
+
+    // the coroutine resumed once the wait is over, or a null handle if the waiter is a Thread
+    std::coroutine_handle<> coroutine;
+
+    Waiter()
+        : wait_next(nullptr), wait_prev(nullptr), wait_queue(nullptr), transfer(nullptr), wait_result(0), wake_nsecs(0),
+          deadline_index(0), coroutine(nullptr) {}
+};
+
+#endif // WAITER_H
@@ -0,0 +1,47 @@
+#include "work_stealing_deque.h"
+
+WorkStealingDeque::WorkStealingDeque() : top(0), bottom(0), buffer(nullptr), mask(0) {}
+
+WorkStealingDeque::~WorkStealingDeque() {
+    delete[] buffer;
+}
+
+void WorkStealingDeque::init(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+        size *= 2;
+    }
+    delete[] buffer;
+    buffer = new std::atomic<Thread*>[size];
+    mask = size - 1;
+    top.store(0, std::memory_order_relaxed);
+    bottom.store(0, std::memory_order_relaxed);
+}
+
+void WorkStealingDeque::push(Thread* thread) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    buffer[b & mask].store(thread, std::memory_order_relaxed);
+    // The slot must be visible before a thief can see the new bottom
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+Thread* WorkStealingDeque::take() {
+    while (true) {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        Thread* thread = buffer[t & mask].load(std::memory_order_relaxed);
+        if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return thread;
+        }
+        // Another carrier took it first, try the next one
+    }
+}
+
+bool WorkStealingDeque::empty() const {
+    return top.load(std::memory_order_acquire) >= bottom.load(std::memory_order_acquire);
+}
@@ -0,0 +1,43 @@
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class Thread;
+
+/*
+ * A Chase-Lev work-stealing deque of READY threads (in the C11 formulation of Le et al., "Correct and Efficient
+ * Work-Stealing for Weak Memory Models").
+ *
+ * Only the owning carrier pushes, at the bottom. Everybody takes from the top with a compare-and-swap, the owner
+ * included, so a carrier runs its own threads in FIFO order just like the single ready queue, and thieves take the
+ * threads that have waited longest. Nothing is locked and nothing is allocated after init: a thread is in at most one
+ * deque at a time, so a capacity of the thread limit is never exceeded and the array never grows.
+ */
+class WorkStealingDeque {
+public:
+    WorkStealingDeque();
+    ~WorkStealingDeque();
+
+    /* Makes room for capacity threads. Must be called before any other method. */
+    void init(size_t capacity);
+
+    /* Appends thread at the bottom. Called by the owner only. */
+    void push(Thread* thread);
+
+    /* Removes and returns the thread at the top, or nullptr if the deque is empty. Called by any carrier. */
+    Thread* take();
+
+    /* Whether the deque looked empty at some point during the call. */
+    bool empty() const;
+
+private:
+    std::atomic<int64_t> top;
+    std::atomic<int64_t> bottom;
+    std::atomic<Thread*>* buffer;
+    int64_t mask;
+};
+
+#endif // WORK_STEALING_DEQUE_H